@@ -0,0 +1,468 @@
+// Benchmarks of the renderer's hot paths, printed as JSON so results can be compared between versions:
+//   rasterizer_bench [--filter text] [--min-time seconds] > results.json
+// Every case is run in batches until --min-time has passed, the reported time per iteration is the median batch.
+
+#include "buffer.h"
+#include "renderer.h"
+#include "mesh.h"
+#include "meshBuilder.h"
+#include "light.h"
+#include "texture.h"
+#include "qoi.h"
+#include "threadPool.h"
+#include "math/float3.h"
+#include "math/float4.h"
+#include "math/float4x4.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr int ScreenWidth = 500;
+static constexpr int ScreenHeight = 400;
+static constexpr uint32_t ClearColor = 0xff000000;
+static constexpr int BatchCount = 5;
+
+struct Benchmark
+{
+	std::string name;
+	std::function<void()> run;
+	// Work done by one run, zero when it doesn't apply
+	double triangles = 0;
+	double pixels = 0;
+	double operations = 0;
+};
+
+struct Result
+{
+	const Benchmark* benchmark;
+	long long iterations;
+	double nsPerIteration;
+	double nsPerIterationMin;
+};
+
+// Keeps results alive so the compiler can't drop the work producing them
+static volatile float g_sink;
+
+static double Seconds(std::chrono::steady_clock::duration duration)
+{
+	return std::chrono::duration<double>(duration).count();
+}
+
+static Result Measure(const Benchmark& benchmark, double minSeconds)
+{
+	// Warm up caches and the thread pool, and find how many iterations fill a batch
+	long long batchIterations = 1;
+	while (true)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (long long i = 0; i < batchIterations; i++)
+		{
+			benchmark.run();
+		}
+		const double seconds = Seconds(std::chrono::steady_clock::now() - start);
+		if (seconds >= minSeconds / BatchCount || batchIterations >= (1ll << 30))
+		{
+			break;
+		}
+		batchIterations = seconds <= 0.0 ? batchIterations * 16 : std::max(batchIterations * 2, (long long)(batchIterations * (minSeconds / BatchCount) / seconds));
+	}
+
+	std::vector<double> batchTimes;
+	for (int batch = 0; batch < BatchCount; batch++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (long long i = 0; i < batchIterations; i++)
+		{
+			benchmark.run();
+		}
+		batchTimes.push_back(Seconds(std::chrono::steady_clock::now() - start) * 1e9 / batchIterations);
+	}
+	std::sort(batchTimes.begin(), batchTimes.end());
+
+	return Result{ &benchmark, batchIterations * BatchCount, batchTimes[BatchCount / 2], batchTimes[0] };
+}
+
+struct Scene
+{
+	// Looks past the origin, the renderer doesn't expect fragments exactly at it
+	Camera camera{ float3(0, 0, 4), float3(0, 0, -1) };
+	DirectionalLight directionalLight{ float3(1, 1, 1), float3(1, 1, 1) * 0.2f };
+	std::vector<PointLight> pointLights{ PointLight{ float3(0, 0, 2), float3(1, 1, 1) * 0.65f } };
+	SpotLight spotLight{ float3(0, 3, 2), float3(0, -1, 0), float3(1, 1, 0) * 0.35f, cosf(3.14f / 6.0f) };
+};
+
+static void Draw(Buffer& buffer, const Scene& scene, const Mesh& mesh, const Transform& transform, Renderer::CullMode cullMode)
+{
+	buffer.ClearColor(ClearColor);
+	buffer.ClearDepth();
+	Renderer::DrawMesh(buffer, mesh, transform, scene.camera, scene.directionalLight, scene.pointLights, scene.spotLight, Renderer::Pass::Full, cullMode);
+}
+
+// Pixels that got drawn, found once after a draw. The scene is lit, so nothing is shaded with the clear color.
+static double CountDrawnPixels(const Buffer& buffer)
+{
+	std::vector<uint32_t> pixels((size_t)buffer.GetWidth() * buffer.GetHeight());
+	buffer.ResolveColor(pixels.data());
+	return (double)std::count_if(pixels.begin(), pixels.end(), [](uint32_t pixel) { return pixel != ClearColor; });
+}
+
+// Triangles in the plane through the camera target, which the camera sees head on. Positions are given in pixels.
+class ScreenMesh
+{
+public:
+	explicit ScreenMesh(const Camera& camera)
+	{
+		const float distance = (camera.position - camera.target).Magnitude();
+		m_halfHeight = distance * tanf(22.5f * (float)M_PI / 180.0f); // the projection has a 45 degree vertical FOV
+		m_halfWidth = m_halfHeight * ScreenWidth / ScreenHeight;
+		m_center = camera.target;
+	}
+
+	void AddTriangle(float x1, float y1, float x2, float y2, float x3, float y3)
+	{
+		const int first = (int)mesh.vertices.size();
+		mesh.vertices.push_back(Vertex(ToWorld(x1, y1), float3(0, 0, 1)));
+		mesh.vertices.push_back(Vertex(ToWorld(x2, y2), float3(0, 0, 1)));
+		mesh.vertices.push_back(Vertex(ToWorld(x3, y3), float3(0, 0, 1)));
+		mesh.indices.push_back(int3(first, first + 1, first + 2));
+	}
+
+	float3 ToWorld(float x, float y) const
+	{
+		return m_center + float3((x / ScreenWidth * 2.0f - 1.0f) * m_halfWidth, (y / ScreenHeight * 2.0f - 1.0f) * m_halfHeight, 0.0f);
+	}
+
+	Mesh mesh;
+
+private:
+	float3 m_center;
+	float m_halfWidth;
+	float m_halfHeight;
+};
+
+// Screen covered by a grid of cells, each holding one triangle over half of it
+static Mesh BuildTriangleGrid(const Camera& camera, int cellSize)
+{
+	ScreenMesh screen(camera);
+	for (int y = 0; y + cellSize <= ScreenHeight; y += cellSize)
+	{
+		for (int x = 0; x + cellSize <= ScreenWidth; x += cellSize)
+		{
+			screen.AddTriangle((float)x, (float)y, (float)(x + cellSize), (float)y, (float)x, (float)(y + cellSize));
+		}
+	}
+	screen.mesh.RebuildStreams();
+	return screen.mesh;
+}
+
+// One triangle around the whole screen, clipped by the renderer
+static Mesh BuildFullScreenTriangle(const Camera& camera)
+{
+	ScreenMesh screen(camera);
+	screen.AddTriangle(-10.0f, -10.0f, 2.0f * ScreenWidth + 10.0f, -10.0f, -10.0f, 2.0f * ScreenHeight + 10.0f);
+	screen.mesh.RebuildStreams();
+	return screen.mesh;
+}
+
+static Buffer* BuildCheckerImage(int size)
+{
+	Buffer* image = new Buffer((unsigned short)size, (unsigned short)size);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			const uint32_t shade = ((x / 8 + y / 8) % 2) ? 0xe0 : 0x20;
+			image->ColorAt(x, y) = 0xff000000 | (shade << 16) | ((uint32_t)(x & 0xff) << 8) | (uint32_t)(y & 0xff);
+		}
+	}
+	return image;
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = nullptr;
+	double minSeconds = 1.0;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--filter") == 0)
+		{
+			filter = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "--min-time") == 0)
+		{
+			minSeconds = atof(argv[i + 1]);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--filter text] [--min-time seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Benchmark> benchmarks;
+	Scene scene;
+	Buffer buffer(ScreenWidth, ScreenHeight, Buffer::Layout::Tiled);
+	const Transform identity{ float3(0, 0, 0), float3(0, 0, 0), float3(1, 1, 1) };
+
+	// Triangle setup and rasterization: a screen full of small or medium triangles, and one triangle covering it all
+	struct TriangleCase
+	{
+		const char* name;
+		Mesh mesh;
+	};
+	std::vector<TriangleCase> triangleCases;
+	triangleCases.push_back(TriangleCase{ "triangles/small_4px", BuildTriangleGrid(scene.camera, 4) });
+	triangleCases.push_back(TriangleCase{ "triangles/medium_32px", BuildTriangleGrid(scene.camera, 32) });
+	triangleCases.push_back(TriangleCase{ "triangles/full_screen", BuildFullScreenTriangle(scene.camera) });
+	for (const TriangleCase& triangleCase : triangleCases)
+	{
+		const Mesh* mesh = &triangleCase.mesh;
+		Benchmark benchmark;
+		benchmark.name = triangleCase.name;
+		benchmark.run = [&buffer, &scene, &identity, mesh]() { Draw(buffer, scene, *mesh, identity, Renderer::CullMode::None); };
+		benchmark.triangles = (double)mesh->indices.size();
+		benchmarks.push_back(benchmark);
+	}
+
+	// Whole meshes: vertex transform, culling, binning and shading
+	std::vector<int> subdivisions = { 10, 25, 50, 100, 200 };
+	std::vector<Mesh> spheres;
+	spheres.reserve(subdivisions.size());
+	for (int subdivision : subdivisions)
+	{
+		spheres.push_back(MeshBuilder::BuildUnitSphere(subdivision));
+		const Mesh* sphere = &spheres.back();
+
+		Benchmark benchmark;
+		benchmark.name = "mesh/sphere_" + std::to_string(subdivision);
+		benchmark.run = [&buffer, &scene, &identity, sphere]() { Draw(buffer, scene, *sphere, identity, Renderer::CullMode::Back); };
+		benchmark.triangles = (double)sphere->indices.size();
+		benchmarks.push_back(benchmark);
+	}
+
+	// Point lights scattered in front of the full screen triangle, with ranges shrinking as their number grows so about 8 of them
+	// reach every pixel. Each pixel only evaluates the lights of its cluster, so the time should stay about the same.
+	std::vector<std::unique_ptr<Scene>> lightScenes;
+	for (int lightCount : { 16, 256, 1024, 4096 })
+	{
+		lightScenes.emplace_back(new Scene());
+		Scene* lightScene = lightScenes.back().get();
+		lightScene->pointLights.clear();
+
+		ScreenMesh screen(lightScene->camera);
+		const float3 screenMin = screen.ToWorld(0.0f, 0.0f);
+		const float3 screenMax = screen.ToWorld((float)ScreenWidth, (float)ScreenHeight);
+		const float area = (screenMax.x - screenMin.x) * (screenMax.y - screenMin.y);
+		const float range = sqrtf(8.0f * area / ((float)M_PI * lightCount));
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+		for (int i = 0; i < lightCount; i++)
+		{
+			const float3 position(
+				screenMin.x + (screenMax.x - screenMin.x) * distribution(random),
+				screenMin.y + (screenMax.y - screenMin.y) * distribution(random),
+				screenMin.z + 0.5f * range * distribution(random));
+			PointLight light{ position, float3(distribution(random), distribution(random), distribution(random)) * 0.25f };
+			light.range = range;
+			lightScene->pointLights.push_back(light);
+		}
+
+		const Mesh* mesh = &triangleCases[2].mesh;
+		Benchmark benchmark;
+		benchmark.name = "lights/clustered_" + std::to_string(lightCount);
+		benchmark.run = [&buffer, &identity, lightScene, mesh]() { Draw(buffer, *lightScene, *mesh, identity, Renderer::CullMode::None); };
+		benchmark.triangles = (double)mesh->indices.size();
+		benchmarks.push_back(benchmark);
+	}
+
+	// Texture sampling: a 256x256 pixel quad rotated over a 512x512 texture, one level above the base level
+	constexpr int SampleGridSize = 256;
+	std::vector<float> uvs;
+	for (int y = 0; y < SampleGridSize; y++)
+	{
+		for (int x = 0; x < SampleGridSize; x++)
+		{
+			const float angle = 0.5f;
+			const float u = ((x - SampleGridSize / 2) * cosf(angle) - (y - SampleGridSize / 2) * sinf(angle)) / (SampleGridSize * 1.5f) + 0.5f;
+			const float v = ((x - SampleGridSize / 2) * sinf(angle) + (y - SampleGridSize / 2) * cosf(angle)) / (SampleGridSize * 1.5f) + 0.5f;
+			uvs.push_back(u);
+			uvs.push_back(v);
+		}
+	}
+
+	std::unique_ptr<Buffer> checkerImage(BuildCheckerImage(512));
+	const std::pair<Texture::Layout, const char*> layouts[] = {
+		{ Texture::Layout::Linear, "linear" }, { Texture::Layout::Tiled, "tiled" }, { Texture::Layout::Morton, "morton" } };
+	const std::pair<Texture::Filter, const char*> filters[] = {
+		{ Texture::Filter::Point, "point" }, { Texture::Filter::Bilinear, "bilinear" }, { Texture::Filter::Trilinear, "trilinear" } };
+	std::vector<std::unique_ptr<Texture>> textures;
+	for (const auto& layout : layouts)
+	{
+		for (const auto& filter : filters)
+		{
+			textures.emplace_back(new Texture(*checkerImage, layout.first));
+			textures.back()->filter = filter.first;
+			const Texture* texture = textures.back().get();
+
+			Benchmark benchmark;
+			benchmark.name = std::string("texture/") + filter.second + "_" + layout.second;
+			benchmark.run = [texture, &uvs]()
+			{
+				float sum = 0.0f;
+				for (size_t i = 0; i < uvs.size(); i += 2)
+				{
+					sum += texture->Sample(uvs[i], uvs[i + 1], 1.5f).x;
+				}
+				g_sink = sum;
+			};
+			benchmark.pixels = (double)(uvs.size() / 2);
+			benchmarks.push_back(benchmark);
+		}
+	}
+
+	// Matrix math over arrays, like the vertex stage and the per draw setup
+	constexpr int MathCount = 4096;
+	std::vector<float4x4> matrices;
+	std::vector<float4> vectors;
+	for (int i = 0; i < MathCount; i++)
+	{
+		matrices.push_back(float4x4::Translate(float3(i * 0.01f, 1, 2)) * float4x4::Rotate(i * 0.1f, float3(0, 1, 0)) * float4x4::Scale(float3(1, 2, 3)));
+		vectors.push_back(float4{ i * 0.5f, 1.0f, -i * 0.25f, 1.0f });
+	}
+	{
+		Benchmark benchmark;
+		benchmark.name = "math/float4x4_mul_float4";
+		benchmark.run = [&matrices, &vectors]()
+		{
+			const float4x4& matrix = matrices[0];
+			float sum = 0.0f;
+			for (const float4& vector : vectors)
+			{
+				sum += (matrix * vector).w;
+			}
+			g_sink = sum;
+		};
+		benchmark.operations = MathCount;
+		benchmarks.push_back(benchmark);
+
+		benchmark.name = "math/float4x4_mul_float4x4";
+		benchmark.run = [&matrices]()
+		{
+			float4x4 product = float4x4::Identity();
+			for (const float4x4& matrix : matrices)
+			{
+				product = matrix * product;
+				product.m33 = 1.0f; // keeps the values from running off
+			}
+			g_sink = product.m00;
+		};
+		benchmarks.push_back(benchmark);
+
+		benchmark.name = "math/float4x4_inverse";
+		benchmark.run = [&matrices]()
+		{
+			float sum = 0.0f;
+			for (const float4x4& matrix : matrices)
+			{
+				sum += matrix.Inverse().m00;
+			}
+			g_sink = sum;
+		};
+		benchmarks.push_back(benchmark);
+	}
+
+	// Image codecs on a rendered frame, in memory
+	Buffer frame(ScreenWidth, ScreenHeight);
+	Draw(frame, scene, spheres[3], Transform{ float3(0, 0, 0), float3(0, 0, 0), float3(1, 1, 1) * 1.5f }, Renderer::CullMode::Back);
+	const uint32_t* frameTopRow = static_cast<const uint32_t*>(frame.Data()) + (size_t)(ScreenHeight - 1) * ScreenWidth;
+	std::vector<uint8_t> encoded;
+	std::vector<uint32_t> decoded((size_t)ScreenWidth * ScreenHeight);
+	Qoi::Encode(frameTopRow, -ScreenWidth, ScreenWidth, ScreenHeight, encoded);
+	{
+		Benchmark benchmark;
+		benchmark.name = "codec/qoi_encode";
+		benchmark.run = [frameTopRow]()
+		{
+			std::vector<uint8_t> output;
+			Qoi::Encode(frameTopRow, -ScreenWidth, ScreenWidth, ScreenHeight, output);
+			g_sink = (float)output.size();
+		};
+		benchmark.pixels = (double)ScreenWidth * ScreenHeight;
+		benchmarks.push_back(benchmark);
+
+		benchmark.name = "codec/qoi_encode_parallel";
+		benchmark.run = [frameTopRow]()
+		{
+			std::vector<uint8_t> output;
+			Qoi::Encode(frameTopRow, -ScreenWidth, ScreenWidth, ScreenHeight, output, (int)ThreadPool::Get().GetThreadCount());
+			g_sink = (float)output.size();
+		};
+		benchmarks.push_back(benchmark);
+
+		benchmark.name = "codec/qoi_decode";
+		benchmark.run = [&encoded, &decoded]()
+		{
+			Qoi::Decode(encoded.data(), encoded.size(), decoded.data(), ScreenWidth);
+			g_sink = (float)decoded[0];
+		};
+		benchmarks.push_back(benchmark);
+	}
+
+	// Shaded pixels of the draws, counted once up front
+	for (Benchmark& benchmark : benchmarks)
+	{
+		if (benchmark.triangles > 0)
+		{
+			benchmark.run();
+			benchmark.pixels = CountDrawnPixels(buffer);
+		}
+	}
+
+	printf("{\n");
+	printf("  \"width\": %d,\n", ScreenWidth);
+	printf("  \"height\": %d,\n", ScreenHeight);
+	printf("  \"threads\": %u,\n", ThreadPool::Get().GetThreadCount());
+	printf("  \"benchmarks\": [");
+	bool first = true;
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		if (filter != nullptr && benchmark.name.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		const Result result = Measure(benchmark, minSeconds);
+		const double seconds = result.nsPerIteration * 1e-9;
+
+		printf("%s\n    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_iteration\": %.1f, \"ns_per_iteration_min\": %.1f",
+			first ? "" : ",", benchmark.name.c_str(), result.iterations, result.nsPerIteration, result.nsPerIterationMin);
+		if (benchmark.triangles > 0)
+		{
+			printf(", \"triangles\": %.0f, \"mtris_per_s\": %.3f", benchmark.triangles, benchmark.triangles / seconds * 1e-6);
+		}
+		if (benchmark.pixels > 0)
+		{
+			printf(", \"pixels\": %.0f, \"mpixels_per_s\": %.3f, \"ns_per_fragment\": %.3f", benchmark.pixels, benchmark.pixels / seconds * 1e-6, result.nsPerIteration / benchmark.pixels);
+		}
+		if (benchmark.operations > 0)
+		{
+			printf(", \"operations\": %.0f, \"mops_per_s\": %.3f, \"ns_per_op\": %.3f", benchmark.operations, benchmark.operations / seconds * 1e-6, result.nsPerIteration / benchmark.operations);
+		}
+		printf("}");
+		fflush(stdout);
+		first = false;
+	}
+	printf("\n  ]\n}\n");
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+// Allocator for std::vector that aligns the storage, so streams can be loaded with aligned SIMD loads
+template <typename T, size_t Alignment>
+struct AlignedAllocator
+{
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() = default;
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count)
+	{
+#ifdef _MSC_VER
+		void* memory = _aligned_malloc(count * sizeof(T), Alignment);
+#else
+		void* memory = nullptr;
+		if (posix_memalign(&memory, Alignment, count * sizeof(T)) != 0)
+		{
+			memory = nullptr;
+		}
+#endif
+		if (memory == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		return static_cast<T*>(memory);
+	}
+
+	void deallocate(T* memory, size_t)
+	{
+#ifdef _MSC_VER
+		_aligned_free(memory);
+#else
+		free(memory);
+#endif
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// Cache line alignment, enough for any SIMD load
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 64>>;
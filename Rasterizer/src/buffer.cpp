@@ -1,89 +1,514 @@
 #include "buffer.h"
 
+#include "mappedFile.h"
+#include "profiler.h"
+#include "qoi.h"
+#include "threadPool.h"
+
+#include <algorithm>
 #include <cstdint>
 #include <assert.h>
 #include <cstdio>
 #include <limits>
+#include <vector>
 
 // Ignore visual studio warning
 #pragma warning(disable : 4996) //_CRT_SECURE_NO_WARNINGS
 
-Buffer::Buffer(unsigned short width, unsigned short height) 
-    : m_width(width), m_height(height) 
+static_assert(Buffer::TileSize % Buffer::HiZBlockSize == 0, "Hi-Z blocks must not straddle tiles");
+
+Buffer::Buffer(unsigned short width, unsigned short height, Layout layout) 
+    : m_layout(layout), m_width(width), m_height(height) 
 {
-    m_colorBuffer = new uint32_t[width * height] { 0 };
+    m_tilesX = (width + TileSize - 1) / TileSize;
+    m_tilesY = (height + TileSize - 1) / TileSize;
+    m_tileStates = new uint8_t[m_tilesX * m_tilesY] { 0 };
+
+    // Tiled storage is padded to whole tiles
+    const int pixelCount = layout == Layout::Tiled ? m_tilesX * m_tilesY * TileSize * TileSize : width * height;
+
+    m_colorBuffer = new uint32_t[pixelCount] { 0 };
     assert(m_colorBuffer != nullptr && "Color buffer must not be nullptr!");
 
-    m_depthBuffer = new float[width * height];
+    m_depthBuffer = new float[pixelCount];
     assert(m_depthBuffer != nullptr && "Depth must not be nullptr");
-    for (int i = 0; i < m_width * m_height; i++)
+    for (int i = 0; i < pixelCount; i++)
     {
         // TODO : what is a good initial value for the depth buffer?
         m_depthBuffer[i] = std::numeric_limits<float>::max();
     }
+
+    m_hiZWidth = (width + HiZBlockSize - 1) / HiZBlockSize;
+    m_hiZHeight = (height + HiZBlockSize - 1) / HiZBlockSize;
+    m_hiZ = new float[m_hiZWidth * m_hiZHeight];
+    for (int i = 0; i < m_hiZWidth * m_hiZHeight; i++)
+    {
+        m_hiZ[i] = std::numeric_limits<float>::max();
+    }
+
+    m_clearColor = 0;
+    m_clearDepth = std::numeric_limits<float>::max();
 }
 
-Buffer::~Buffer() 
+Buffer::Buffer(unsigned short width, unsigned short height, uint32_t* externalColor)
+    : Buffer(width, height, Layout::Linear)
 {
+    assert(externalColor != nullptr);
     delete[] m_colorBuffer;
+    m_colorBuffer = externalColor;
+    m_ownsColor = false;
+}
+
+Buffer::~Buffer() 
+{
+    if (m_ownsColor)
+    {
+        delete[] m_colorBuffer;
+    }
     m_colorBuffer = nullptr;
     delete[] m_depthBuffer;
     m_depthBuffer = nullptr;
+    delete[] m_hiZ;
+    m_hiZ = nullptr;
+    delete[] m_tileStates;
+    m_tileStates = nullptr;
 }
 
 void Buffer::ClearColor(uint32_t argb) 
 {
+    m_clearColor = argb;
+    if (m_layout == Layout::Tiled)
+    {
+        for (int i = 0; i < m_tilesX * m_tilesY; i++)
+        {
+            m_tileStates[i] |= ColorPending;
+        }
+        return;
+    }
+
     for (int i = 0; i < m_width * m_height; i++)
     {
         m_colorBuffer[i] = argb;
     }
 }
 
-void Buffer::SaveTGAFile(const char* filename) 
+void Buffer::ClearDepth(float depth)
 {
+    m_clearDepth = depth;
+    if (m_layout == Layout::Tiled)
+    {
+        for (int i = 0; i < m_tilesX * m_tilesY; i++)
+        {
+            m_tileStates[i] |= DepthPending;
+        }
+        return;
+    }
+
+    for (int i = 0; i < m_width * m_height; i++)
+    {
+        m_depthBuffer[i] = depth;
+    }
+    for (int i = 0; i < m_hiZWidth * m_hiZHeight; i++)
+    {
+        m_hiZ[i] = depth;
+    }
+}
+
+void Buffer::PrepareTile(int tileX, int tileY)
+{
+    if (m_layout != Layout::Tiled)
+    {
+        return;
+    }
+
+    uint8_t& state = m_tileStates[tileY * m_tilesX + tileX];
+    if (state == 0)
+    {
+        return;
+    }
+
+    const int tilePixels = TileSize * TileSize;
+    const size_t first = (size_t)(tileY * m_tilesX + tileX) * tilePixels;
+    if (state & ColorPending)
+    {
+        std::fill(m_colorBuffer + first, m_colorBuffer + first + tilePixels, m_clearColor);
+    }
+
+    if (state & DepthPending)
+    {
+        std::fill(m_depthBuffer + first, m_depthBuffer + first + tilePixels, m_clearDepth);
+
+        constexpr int BlocksPerTile = TileSize / HiZBlockSize;
+        const int blockXMax = std::min((tileX + 1) * BlocksPerTile, m_hiZWidth);
+        const int blockYMax = std::min((tileY + 1) * BlocksPerTile, m_hiZHeight);
+        for (int blockY = tileY * BlocksPerTile; blockY < blockYMax; blockY++)
+        {
+            for (int blockX = tileX * BlocksPerTile; blockX < blockXMax; blockX++)
+            {
+                m_hiZ[blockY * m_hiZWidth + blockX] = m_clearDepth;
+            }
+        }
+    }
+
+    state = 0;
+}
+
+void Buffer::ResolveColor(uint32_t* destination) const
+{
+    if (m_layout == Layout::Linear)
+    {
+        std::copy(m_colorBuffer, m_colorBuffer + m_width * m_height, destination);
+        return;
+    }
+
+    for (int y = 0; y < m_height; y++)
+    {
+        ResolveRow(y, destination + (size_t)y * m_width);
+    }
+}
+
+void Buffer::ResolveRow(int y, uint32_t* destination) const
+{
+    if (m_layout == Layout::Linear)
+    {
+        std::copy(m_colorBuffer + (size_t)y * m_width, m_colorBuffer + (size_t)(y + 1) * m_width, destination);
+        return;
+    }
+
+    for (int tileX = 0; tileX < m_tilesX; tileX++)
+    {
+        const int xMin = tileX * TileSize;
+        const int count = std::min(TileSize, (int)m_width - xMin);
+        if (m_tileStates[(y / TileSize) * m_tilesX + tileX] & ColorPending)
+        {
+            std::fill(destination + xMin, destination + xMin + count, m_clearColor);
+        }
+        else
+        {
+            const uint32_t* tileRow = &m_colorBuffer[PixelIndex(xMin, y)];
+            std::copy(tileRow, tileRow + count, destination + xMin);
+        }
+    }
+}
+
+void Buffer::UpdateHiZ(int blockX, int blockY)
+{
+    const int xMax = std::min((blockX + 1) * HiZBlockSize, (int)m_width);
+    const int yMax = std::min((blockY + 1) * HiZBlockSize, (int)m_height);
+
+    float farthest = -std::numeric_limits<float>::max();
+    for (int y = blockY * HiZBlockSize; y < yMax; y++)
+    {
+        for (int x = blockX * HiZBlockSize; x < xMax; x++)
+        {
+            farthest = std::max(farthest, DepthAt(x, y));
+        }
+    }
+
+    m_hiZ[blockY * m_hiZWidth + blockX] = farthest;
+}
+
+bool Buffer::IsOccluded(int xMin, int yMin, int xMax, int yMax, float minDepth) const
+{
+    xMin = std::max(xMin, 0);
+    yMin = std::max(yMin, 0);
+    xMax = std::min(xMax, (int)m_width);
+    yMax = std::min(yMax, (int)m_height);
+    if (xMin >= xMax || yMin >= yMax)
+    {
+        return false;
+    }
+
+    for (int blockY = yMin / HiZBlockSize; blockY <= (yMax - 1) / HiZBlockSize; blockY++)
+    {
+        for (int blockX = xMin / HiZBlockSize; blockX <= (xMax - 1) / HiZBlockSize; blockX++)
+        {
+            // Strict comparison, so pixels at exactly the stored depth still reach the depth test
+            if (!(minDepth > HiZAt(blockX, blockY)))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// TGA header fields, see the Truevision TGA specification
+static constexpr size_t TGAHeaderSize = 18;
+static constexpr uint8_t TGAUncompressedTrueColor = 2;
+static constexpr uint8_t TGARLETrueColor = 10;
+static constexpr uint8_t TGADescriptorRightToLeft = 0x10;
+static constexpr uint8_t TGADescriptorTopToBottom = 0x20;
+
+static uint16_t ReadUint16(const uint8_t* data)
+{
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static void AppendPixel(std::vector<uint8_t>& output, uint32_t argb)
+{
+    output.push_back((uint8_t)(argb >> 0));
+    output.push_back((uint8_t)(argb >> 8));
+    output.push_back((uint8_t)(argb >> 16));
+    output.push_back((uint8_t)(argb >> 24));
+}
+
+// Packets never cross rows, so rows can be encoded independently
+static void EncodeRLERow(const uint32_t* row, int width, std::vector<uint8_t>& output)
+{
+    constexpr int MaxPacketLength = 128;
+
+    int x = 0;
+    while (x < width)
+    {
+        int run = 1;
+        while (x + run < width && run < MaxPacketLength && row[x + run] == row[x])
+        {
+            run++;
+        }
+
+        if (run > 1)
+        {
+            output.push_back((uint8_t)(0x80 | (run - 1)));
+            AppendPixel(output, row[x]);
+            x += run;
+            continue;
+        }
+
+        // Raw packet up to the start of the next run
+        int count = 1;
+        while (x + count < width && count < MaxPacketLength && (x + count + 1 >= width || row[x + count] != row[x + count + 1]))
+        {
+            count++;
+        }
+
+        output.push_back((uint8_t)(count - 1));
+        for (int i = 0; i < count; i++)
+        {
+            AppendPixel(output, row[x + i]);
+        }
+        x += count;
+    }
+}
+
+void Buffer::SaveTGAFile(const char* filename, bool compressed, bool parallel) 
+{
+    PROFILE_SCOPE("SaveTGAFile");
+
     unsigned short header[9] = {
-        0x0000, 0x0002, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, compressed ? TGARLETrueColor : TGAUncompressedTrueColor, 0x0000, 0x0000, 0x0000, 0x0000,
         m_width, m_height,
         0x0820
     };
 
+    std::vector<uint32_t> resolved;
+    const uint32_t* pixels = m_colorBuffer;
+    if (m_layout != Layout::Linear)
+    {
+        resolved.resize((size_t)m_width * m_height);
+        ResolveColor(resolved.data());
+        pixels = resolved.data();
+    }
+
     FILE* file = fopen(filename, "wb+");
     assert(file != nullptr && "failed to open file for writing");
     fwrite(header, 2, 9, file);
-    fwrite(m_colorBuffer, 4, m_width * m_height, file);
+    if (compressed)
+    {
+        std::vector<std::vector<uint8_t>> rows(m_height);
+        auto encodeRow = [&](int y)
+        {
+            EncodeRLERow(pixels + (size_t)y * m_width, m_width, rows[y]);
+        };
+        if (parallel)
+        {
+            ThreadPool::Get().ParallelFor(m_height, encodeRow);
+        }
+        else
+        {
+            for (int y = 0; y < m_height; y++)
+            {
+                encodeRow(y);
+            }
+        }
+
+        for (const std::vector<uint8_t>& row : rows)
+        {
+            fwrite(row.data(), 1, row.size(), file);
+        }
+    }
+    else
+    {
+        fwrite(pixels, 4, m_width * m_height, file);
+    }
     fclose(file);
 }
 
-// #include <iostream>
-
 void Buffer::ReadTGAFromFile(const char* filename) 
 {
-    FILE* file = fopen(filename, "rb");
-    assert(file != nullptr && "Failed to open file for reading");
-
-    unsigned short header[9] = {0};
-    int read = fread(&header, 2, 9, file);
-    // std::cout << read << " read bytes\n" << "error: " << ferror(file) << ", eof: " << feof(file) << '\n';
-    m_width = header[6];
-    m_height = header[7];
-    // std::cout << m_width <<'\n';
-    // std::cout << m_height <<'\n';
-
-    delete [] m_colorBuffer;
-    m_colorBuffer = new uint32_t[m_width*m_height];
-    uint8_t* buffer = new uint8_t[3 * m_width * m_height]; // skip alpha
-    fread(buffer, sizeof(uint8_t) * 3, m_width * m_height, file);
-    int pixel = 0;
-    for (int i = 0; i < 3 * m_width * m_height; i+=3) {
-        uint8_t blue = buffer[i+0];
-        uint8_t green = buffer[i+1];
-        uint8_t red = buffer[i+2];
-        uint32_t color = (0xff << 24) | (red << 16) | (green << 8) | (blue << 0);
-        m_colorBuffer[pixel] = color;
-        pixel++;
-    }
-
-    delete [] buffer;
-    
+    assert(m_layout == Layout::Linear && "images are only loaded into linear buffers");
+
+    MappedFile file(filename);
+    assert(file.IsOpen() && "Failed to open file for reading");
+    if (file.IsOpen() == false || file.Size() < TGAHeaderSize)
+    {
+        return;
+    }
+
+    const uint8_t* data = file.Data();
+    const uint8_t idLength = data[0];
+    const uint8_t colorMapType = data[1];
+    const uint8_t imageType = data[2];
+    const uint16_t colorMapLength = ReadUint16(data + 5);
+    const uint8_t colorMapEntryBits = data[7];
+    const uint16_t width = ReadUint16(data + 12);
+    const uint16_t height = ReadUint16(data + 14);
+    const uint8_t bitsPerPixel = data[16];
+    const uint8_t descriptor = data[17];
+
+    const bool supported = (imageType == TGAUncompressedTrueColor || imageType == TGARLETrueColor) && (bitsPerPixel == 24 || bitsPerPixel == 32) && width > 0 && height > 0;
+    assert(supported && "only uncompressed or RLE true color TGA files with 24 or 32 bits per pixel are supported");
+    if (supported == false)
+    {
+        return;
+    }
+
+    // The ID field and an unused color map sit between the header and the pixels
+    const size_t pixelsOffset = TGAHeaderSize + idLength + (colorMapType != 0 ? colorMapLength * ((colorMapEntryBits + 7) / 8) : 0);
+    const int bytesPerPixel = bitsPerPixel / 8;
+    if (pixelsOffset > file.Size())
+    {
+        assert(false && "TGA file is truncated");
+        return;
+    }
+
+    // Only the color image is replaced, every pixel of it is written below
+    assert(m_ownsColor && "external color memory can't be resized");
+    delete[] m_colorBuffer;
+    m_width = width;
+    m_height = height;
+    m_colorBuffer = new uint32_t[(size_t)width * height];
+
+    // Row 0 of the buffer is the bottom row, which is how SaveTGAFile writes it too
+    const bool topToBottom = (descriptor & TGADescriptorTopToBottom) != 0;
+    const bool rightToLeft = (descriptor & TGADescriptorRightToLeft) != 0;
+    auto decodePixel = [bytesPerPixel](const uint8_t* pixel)
+    {
+        const uint32_t alpha = bytesPerPixel == 4 ? pixel[3] : 0xff;
+        return (alpha << 24) | (pixel[2] << 16) | (pixel[1] << 8) | (pixel[0] << 0);
+    };
+    auto destinationRow = [&](int fileRow)
+    {
+        return m_colorBuffer + (size_t)(topToBottom ? height - 1 - fileRow : fileRow) * width;
+    };
+
+    const uint8_t* pixels = data + pixelsOffset;
+    const uint8_t* end = data + file.Size();
+    const size_t pixelCount = (size_t)width * height;
+
+    if (imageType == TGAUncompressedTrueColor)
+    {
+        if ((size_t)(end - pixels) < pixelCount * bytesPerPixel)
+        {
+            assert(false && "TGA file is truncated");
+            return;
+        }
+
+        // Every row is at a known offset, so rows are converted in parallel straight from the mapped file
+        ThreadPool::Get().ParallelFor(height, [&](int row)
+        {
+            const uint8_t* source = pixels + (size_t)row * width * bytesPerPixel;
+            uint32_t* destination = destinationRow(row);
+            for (int x = 0; x < width; x++)
+            {
+                destination[rightToLeft ? width - 1 - x : x] = decodePixel(source + x * bytesPerPixel);
+            }
+        });
+        return;
+    }
+
+    // RLE packets can cross rows and their sizes are only known by decoding them, so this part is serial
+    size_t index = 0;
+    while (index < pixelCount)
+    {
+        if (pixels >= end)
+        {
+            assert(false && "TGA file is truncated");
+            return;
+        }
+
+        const uint8_t packet = *pixels++;
+        const size_t count = std::min((size_t)(packet & 0x7f) + 1, pixelCount - index);
+        const bool repeated = (packet & 0x80) != 0;
+        const size_t packetBytes = repeated ? bytesPerPixel : count * bytesPerPixel;
+        if ((size_t)(end - pixels) < packetBytes)
+        {
+            assert(false && "TGA file is truncated");
+            return;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const int x = (int)((index + i) % width);
+            destinationRow((int)((index + i) / width))[rightToLeft ? width - 1 - x : x] = decodePixel(repeated ? pixels : pixels + i * bytesPerPixel);
+        }
+        pixels += packetBytes;
+        index += count;
+    }
+}
+
+void Buffer::SaveQOIFile(const char* filename, bool parallel)
+{
+    PROFILE_SCOPE("SaveQOIFile");
+
+    std::vector<uint32_t> resolved;
+    const uint32_t* pixels = m_colorBuffer;
+    if (m_layout != Layout::Linear)
+    {
+        resolved.resize((size_t)m_width * m_height);
+        ResolveColor(resolved.data());
+        pixels = resolved.data();
+    }
+
+    // QOI stores the top row first, row 0 of the buffer is the bottom one
+    std::vector<uint8_t> encoded;
+    const uint32_t* topRow = pixels + (size_t)(m_height - 1) * m_width;
+    Qoi::Encode(topRow, -(ptrdiff_t)m_width, m_width, m_height, encoded, parallel ? (int)ThreadPool::Get().GetThreadCount() : 1);
+
+    FILE* file = fopen(filename, "wb+");
+    assert(file != nullptr && "failed to open file for writing");
+    fwrite(encoded.data(), 1, encoded.size(), file);
     fclose(file);
 }
+
+void Buffer::ReadQOIFromFile(const char* filename)
+{
+    assert(m_layout == Layout::Linear && "images are only loaded into linear buffers");
+
+    MappedFile file(filename);
+    assert(file.IsOpen() && "Failed to open file for reading");
+    if (file.IsOpen() == false)
+    {
+        return;
+    }
+
+    int width = 0;
+    int height = 0;
+    const bool valid = Qoi::ReadSize(file.Data(), file.Size(), width, height);
+    assert(valid && "not a QOI file");
+    if (valid == false)
+    {
+        return;
+    }
+
+    assert(m_ownsColor && "external color memory can't be resized");
+    delete[] m_colorBuffer;
+    m_width = (unsigned short)width;
+    m_height = (unsigned short)height;
+    m_colorBuffer = new uint32_t[(size_t)width * height];
+
+    const bool decoded = Qoi::Decode(file.Data(), file.Size(), m_colorBuffer + (size_t)(height - 1) * width, -(ptrdiff_t)width);
+    assert(decoded && "QOI file is truncated");
+    (void)decoded;
+}
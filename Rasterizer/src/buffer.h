@@ -1,31 +1,117 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <limits>
 
 class Buffer 
 {
 public:
-    Buffer(unsigned short width, unsigned short height);
+    // Order of the pixels in memory.
+    // Tiled keeps every TileSize x TileSize tile of color and depth contiguous and clears tiles lazily:
+    // a clear only flags the tiles, a tile gets the clear values once PrepareTile is called for it, and tiles
+    // that were never prepared are written with the clear color when the image is resolved.
+    enum class Layout
+    {
+        Linear,
+        Tiled,
+    };
+
+    static constexpr int TileSize = 32;
+
+    Buffer(unsigned short width, unsigned short height, Layout layout = Layout::Linear);
+    // Linear buffer rendering into color memory owned by someone else (e.g. shared memory), width * height pixels
+    Buffer(unsigned short width, unsigned short height, uint32_t* externalColor);
     ~Buffer();
 
     void ClearColor(uint32_t color);
-    void SaveTGAFile(const char* filename);
+    void ClearDepth(float depth = std::numeric_limits<float>::max());
+    // Compressed files are RLE encoded, which mostly helps images with large areas of one color.
+    // parallel encodes on the shared thread pool, a thread that saves while another one renders should pass false
+    // so it doesn't take the pool away from rendering.
+    void SaveTGAFile(const char* filename, bool compressed = false, bool parallel = true);
+    // QOI is lossless, a lot smaller than TGA and fast to encode, strips of rows are encoded in parallel unless parallel is false
+    void SaveQOIFile(const char* filename, bool parallel = true);
+    // Like ReadTGAFromFile, replaces only the color image
+    void ReadQOIFromFile(const char* filename);
+    // Uncompressed or RLE compressed true color images with 24 or 32 bits per pixel.
+    // Replaces only the color image, so a loaded buffer is meant to be used as an image and not rendered into.
     void ReadTGAFromFile(const char* filename);
+    // Raw color storage, row by row only with Layout::Linear. ResolveColor works with any layout.
     void* Data() const { return (void*)m_colorBuffer; }
+    // Writes width * height pixels row by row
+    void ResolveColor(uint32_t* destination) const;
+    // Writes the width pixels of row y
+    void ResolveRow(int y, uint32_t* destination) const;
+
+    Layout GetLayout() const { return m_layout; }
+    // Applies pending clears of the tile, has to be called before its pixels are accessed. Does nothing with Layout::Linear.
+    void PrepareTile(int tileX, int tileY);
     
     unsigned short GetWidth() const { return m_width; }
     unsigned short GetHeight() const { return m_height; }
     float GetAspectRatio() const { return (float)m_width / m_height; }
     
-    uint32_t& ColorAt(int x, int y)         { return m_colorBuffer[y * m_width + x]; }
-    uint32_t ColorAt(int x, int y) const    { return m_colorBuffer[y * m_width + x]; }
+    uint32_t& ColorAt(int x, int y)         { return m_colorBuffer[PixelIndex(x, y)]; }
+    uint32_t ColorAt(int x, int y) const    { return m_colorBuffer[PixelIndex(x, y)]; }
 
-    float& DepthAt(int x, int y)            { return m_depthBuffer[y * m_width + x]; }
-    float DepthAt(int x, int y) const       { return m_depthBuffer[y * m_width + x]; }
+    float& DepthAt(int x, int y)            { return m_depthBuffer[PixelIndex(x, y)]; }
+    float DepthAt(int x, int y) const       { return m_depthBuffer[PixelIndex(x, y)]; }
+
+    // Hierarchical depth: farthest depth of every block of pixels. Whoever writes depth into a block has to call UpdateHiZ.
+    static constexpr int HiZBlockSize = 8;
+    float HiZAt(int blockX, int blockY) const;
+    void UpdateHiZ(int blockX, int blockY);
+    // True when something nearer than minDepth already covers every pixel of the rectangle (max exclusive)
+    bool IsOccluded(int xMin, int yMin, int xMax, int yMax, float minDepth) const;
 
 private:
+    enum TileState : uint8_t
+    {
+        ColorPending = 1 << 0,
+        DepthPending = 1 << 1,
+    };
+
+    size_t PixelIndex(int x, int y) const;
+
+    Layout m_layout;
     uint32_t* m_colorBuffer;
+    bool m_ownsColor = true;
     float* m_depthBuffer;
+    float* m_hiZ;
+    int m_hiZWidth;
+    int m_hiZHeight;
+    uint8_t* m_tileStates; // TileState flags, only used with Layout::Tiled
+    int m_tilesX;
+    int m_tilesY;
+    uint32_t m_clearColor;
+    float m_clearDepth;
     unsigned short m_width;
     unsigned short m_height;
-};
\ No newline at end of file
+};
+
+inline size_t Buffer::PixelIndex(int x, int y) const
+{
+    if (m_layout == Layout::Tiled)
+    {
+        const size_t tile = (size_t)(y / TileSize) * m_tilesX + x / TileSize;
+        return tile * TileSize * TileSize + (y % TileSize) * TileSize + x % TileSize;
+    }
+
+    return (size_t)y * m_width + x;
+}
+
+inline float Buffer::HiZAt(int blockX, int blockY) const
+{
+    // Blocks of a tile that is still waiting for its depth clear are empty
+    if (m_layout == Layout::Tiled)
+    {
+        constexpr int BlocksPerTile = TileSize / HiZBlockSize;
+        if (m_tileStates[(blockY / BlocksPerTile) * m_tilesX + blockX / BlocksPerTile] & DepthPending)
+        {
+            return m_clearDepth;
+        }
+    }
+
+    return m_hiZ[blockY * m_hiZWidth + blockX];
+}
@@ -0,0 +1,166 @@
+#include "coverage.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COVERAGE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define COVERAGE_TARGET_AVX2
+#else
+#define COVERAGE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define COVERAGE_X86 0
+#endif
+
+static uint32_t SpanMaskScalar(const Coverage::Edges& edges)
+{
+	uint32_t mask = 0;
+
+	int e0 = edges.value[0];
+	int e1 = edges.value[1];
+	int e2 = edges.value[2];
+	for (int i = 0; i < Coverage::SpanWidth; i++)
+	{
+		// Sign bit of the OR is set if any of the edges is negative
+		if ((e0 | e1 | e2) >= 0)
+		{
+			mask |= 1u << i;
+		}
+
+		e0 += edges.stepX[0];
+		e1 += edges.stepX[1];
+		e2 += edges.stepX[2];
+	}
+
+	return mask;
+}
+
+#if COVERAGE_X86
+
+static uint32_t SpanMaskSSE2(const Coverage::Edges& edges)
+{
+	__m128i outside0 = _mm_setzero_si128();
+	__m128i outside1 = _mm_setzero_si128();
+
+	for (int e = 0; e < 3; e++)
+	{
+		const int value = edges.value[e];
+		const int step = edges.stepX[e];
+		const __m128i lanes0 = _mm_setr_epi32(value, value + step, value + 2 * step, value + 3 * step);
+		const __m128i lanes1 = _mm_add_epi32(lanes0, _mm_set1_epi32(4 * step));
+		outside0 = _mm_or_si128(outside0, lanes0);
+		outside1 = _mm_or_si128(outside1, lanes1);
+	}
+
+	const uint32_t outsideMask = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(outside0)) | ((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(outside1)) << 4);
+	return ~outsideMask & 0xff;
+}
+
+COVERAGE_TARGET_AVX2
+static uint32_t SpanMaskAVX2(const Coverage::Edges& edges)
+{
+	const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i outside = _mm256_setzero_si256();
+
+	for (int e = 0; e < 3; e++)
+	{
+		const __m256i offsets = _mm256_mullo_epi32(laneIndex, _mm256_set1_epi32(edges.stepX[e]));
+		const __m256i lanes = _mm256_add_epi32(_mm256_set1_epi32(edges.value[e]), offsets);
+		outside = _mm256_or_si256(outside, lanes);
+	}
+
+	const uint32_t outsideMask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(outside));
+	return ~outsideMask & 0xff;
+}
+
+static bool CpuSupportsAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	// AVX2 needs the OS to save the YMM registers too
+	__cpuid(info, 1);
+	const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+	__cpuidex(info, 7, 0);
+	return osSavesYmm && (info[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+typedef uint32_t (*SpanMaskFunction)(const Coverage::Edges& edges);
+
+static Coverage::Kernel DetectKernel()
+{
+#if COVERAGE_X86
+	return CpuSupportsAVX2() ? Coverage::Kernel::AVX2 : Coverage::Kernel::SSE2;
+#else
+	return Coverage::Kernel::Scalar;
+#endif
+}
+
+static SpanMaskFunction GetFunction(Coverage::Kernel kernel)
+{
+	switch (kernel)
+	{
+#if COVERAGE_X86
+	case Coverage::Kernel::SSE2: return SpanMaskSSE2;
+	case Coverage::Kernel::AVX2: return SpanMaskAVX2;
+#endif
+	default: return SpanMaskScalar;
+	}
+}
+
+static Coverage::Kernel s_kernel = DetectKernel();
+static SpanMaskFunction s_spanMask = GetFunction(s_kernel);
+
+uint32_t Coverage::SpanMask(const Edges& edges)
+{
+	return s_spanMask(edges);
+}
+
+void Coverage::SetKernel(Kernel kernel)
+{
+	if (IsSupported(kernel))
+	{
+		s_kernel = kernel;
+		s_spanMask = GetFunction(kernel);
+	}
+}
+
+Coverage::Kernel Coverage::GetKernel()
+{
+	return s_kernel;
+}
+
+bool Coverage::IsSupported(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::Scalar: return true;
+#if COVERAGE_X86
+	case Kernel::SSE2: return true;
+	case Kernel::AVX2: return CpuSupportsAVX2();
+#endif
+	default: return false;
+	}
+}
+
+const char* Coverage::GetKernelName(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::Scalar: return "scalar";
+	case Kernel::SSE2: return "SSE2";
+	case Kernel::AVX2: return "AVX2";
+	default: return "unknown";
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// Coverage testing of pixel spans against the three edge functions of a triangle.
+// The same test is implemented in scalar code and with SSE2/AVX2, picked at runtime. All of them give identical masks.
+namespace Coverage
+{
+	constexpr int SpanWidth = 8;
+
+	struct Edges
+	{
+		// Edge functions at the first pixel of the span, biased so that a pixel is covered when all three are >= 0
+		int value[3];
+		// Change of each edge function when moving one pixel right
+		int stepX[3];
+	};
+
+	enum class Kernel
+	{
+		Scalar,
+		SSE2,
+		AVX2,
+	};
+
+	// Bit i is set when pixel i of the span is inside all three edges
+	uint32_t SpanMask(const Edges& edges);
+
+	// Best kernel the CPU supports is selected on startup, this allows forcing a different one (e.g. to compare results)
+	void SetKernel(Kernel kernel);
+	Kernel GetKernel();
+	bool IsSupported(Kernel kernel);
+	const char* GetKernelName(Kernel kernel);
+}
@@ -0,0 +1,124 @@
+#include "frameStream.h"
+
+#include "buffer.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// BT.601 limited range, 8-bit fixed point
+static uint8_t Luma(uint32_t r, uint32_t g, uint32_t b)
+{
+	return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static uint8_t ChromaBlue(int r, int g, int b)
+{
+	return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static uint8_t ChromaRed(int r, int g, int b)
+{
+	return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+FrameStream::FrameStream(FILE* output, Format format, unsigned short width, unsigned short height, int framesPerSecond)
+	: m_output(output), m_format(format), m_width(width), m_height(height), m_framesPerSecond(framesPerSecond)
+{
+	assert(output != nullptr);
+
+#ifdef _WIN32
+	// stdout is opened in text mode, which would turn every 0x0a byte into 0x0d 0x0a
+	_setmode(_fileno(output), _O_BINARY);
+#endif
+
+	m_rows[0].resize(width);
+	m_rows[1].resize(width);
+	m_plane.resize(width);
+}
+
+const uint32_t* FrameStream::TopDownRow(const Buffer& buffer, int y, uint32_t* scratch) const
+{
+	// Row 0 of the buffer is the bottom one
+	const int bufferRow = m_height - 1 - y;
+	if (buffer.GetLayout() == Buffer::Layout::Linear)
+	{
+		return static_cast<const uint32_t*>(buffer.Data()) + (size_t)bufferRow * m_width;
+	}
+
+	buffer.ResolveRow(bufferRow, scratch);
+	return scratch;
+}
+
+bool FrameStream::Write(const Buffer& buffer)
+{
+	assert(buffer.GetWidth() == m_width && buffer.GetHeight() == m_height);
+
+	if (m_format == Format::RawBGRA)
+	{
+		// 0xAARRGGBB in little endian memory is B, G, R, A
+		for (int y = 0; y < m_height; y++)
+		{
+			fwrite(TopDownRow(buffer, y, m_rows[0].data()), 4, m_width, m_output);
+		}
+		return fflush(m_output) == 0 && ferror(m_output) == 0;
+	}
+
+	if (m_headerWritten == false)
+	{
+		fprintf(m_output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", m_width, m_height, m_framesPerSecond);
+		m_headerWritten = true;
+	}
+	fputs("FRAME\n", m_output);
+
+	// Planes follow each other, so the buffer is read once per plane, a row (or a pair of rows) at a time
+	for (int y = 0; y < m_height; y++)
+	{
+		const uint32_t* row = TopDownRow(buffer, y, m_rows[0].data());
+		for (int x = 0; x < m_width; x++)
+		{
+			m_plane[x] = Luma((row[x] >> 16) & 0xff, (row[x] >> 8) & 0xff, row[x] & 0xff);
+		}
+		fwrite(m_plane.data(), 1, m_width, m_output);
+	}
+
+	// Chroma of every 2x2 block from its average color, the last row/column is repeated for odd sizes
+	const int chromaWidth = (m_width + 1) / 2;
+	const int chromaHeight = (m_height + 1) / 2;
+	for (int plane = 0; plane < 2; plane++)
+	{
+		for (int chromaY = 0; chromaY < chromaHeight; chromaY++)
+		{
+			const uint32_t* top = TopDownRow(buffer, 2 * chromaY, m_rows[0].data());
+			const uint32_t* bottom = TopDownRow(buffer, std::min(2 * chromaY + 1, m_height - 1), m_rows[1].data());
+			for (int chromaX = 0; chromaX < chromaWidth; chromaX++)
+			{
+				const int x0 = 2 * chromaX;
+				const int x1 = std::min(x0 + 1, m_width - 1);
+				const uint32_t texels[4] = { top[x0], top[x1], bottom[x0], bottom[x1] };
+
+				int r = 0;
+				int g = 0;
+				int b = 0;
+				for (uint32_t texel : texels)
+				{
+					r += (texel >> 16) & 0xff;
+					g += (texel >> 8) & 0xff;
+					b += texel & 0xff;
+				}
+				r = (r + 2) / 4;
+				g = (g + 2) / 4;
+				b = (b + 2) / 4;
+
+				m_plane[chromaX] = plane == 0 ? ChromaBlue(r, g, b) : ChromaRed(r, g, b);
+			}
+			fwrite(m_plane.data(), 1, chromaWidth, m_output);
+		}
+	}
+
+	return fflush(m_output) == 0 && ferror(m_output) == 0;
+}
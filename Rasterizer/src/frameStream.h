@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+class Buffer;
+
+// Streams frames into an open file or pipe (usually stdout) for a video encoder, e.g.
+//   Rasterizer --stream 120 y4m | ffmpeg -i - out.mp4
+// Rows are written top first straight from the buffer, at most one row is converted at a time.
+class FrameStream
+{
+public:
+	enum class Format
+	{
+		RawBGRA,	// 4 bytes per pixel, no header
+		Y4M,		// YUV4MPEG2 with 4:2:0 BT.601 limited range YUV
+	};
+
+	FrameStream(FILE* output, Format format, unsigned short width, unsigned short height, int framesPerSecond = 30);
+
+	// False once writing failed, e.g. because the reader closed the pipe
+	bool Write(const Buffer& buffer);
+
+private:
+	// Row y of the image, counted from the top, pointing into the buffer when it is linear
+	const uint32_t* TopDownRow(const Buffer& buffer, int y, uint32_t* scratch) const;
+
+	FILE* m_output;
+	Format m_format;
+	int m_width;
+	int m_height;
+	int m_framesPerSecond;
+	bool m_headerWritten = false;
+	std::vector<uint32_t> m_rows[2];
+	std::vector<uint8_t> m_plane;
+};
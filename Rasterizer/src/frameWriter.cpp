@@ -0,0 +1,98 @@
+#include "frameWriter.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cassert>
+
+FrameWriter::FrameWriter(unsigned short width, unsigned short height, Buffer::Layout layout, Format format, int queueLength)
+	: m_format(format)
+{
+	// One buffer more than the queue holds, that one is being rendered into
+	const int bufferCount = std::max(queueLength, 1) + 1;
+	for (int i = 0; i < bufferCount; i++)
+	{
+		m_buffers.emplace_back(new Buffer(width, height, layout));
+		m_freeBuffers.push_back(m_buffers.back().get());
+	}
+
+	m_thread = std::thread(&FrameWriter::WriterLoop, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_frameQueued.notify_all();
+
+	m_thread.join();
+}
+
+Buffer& FrameWriter::AcquireBuffer()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_bufferFreed.wait(lock, [this]() { return m_freeBuffers.empty() == false; });
+
+	Buffer* buffer = m_freeBuffers.back();
+	m_freeBuffers.pop_back();
+
+	return *buffer;
+}
+
+void FrameWriter::Submit(Buffer& buffer, const std::string& filename)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		assert(std::find(m_freeBuffers.begin(), m_freeBuffers.end(), &buffer) == m_freeBuffers.end() && "buffer was not acquired");
+		m_queue.push_back(PendingFrame{ &buffer, filename });
+	}
+	m_frameQueued.notify_one();
+}
+
+void FrameWriter::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_bufferFreed.wait(lock, [this]() { return m_queue.empty() && m_writing == false; });
+}
+
+void FrameWriter::WriterLoop()
+{
+	Profiler::SetThreadName("Frame writer");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_frameQueued.wait(lock, [this]() { return m_shutdown || m_queue.empty() == false; });
+
+		// Queued frames are still written when shutting down
+		if (m_queue.empty())
+		{
+			return;
+		}
+
+		PendingFrame frame = m_queue.front();
+		m_queue.pop_front();
+		m_writing = true;
+
+		lock.unlock();
+		{
+			PROFILE_SCOPE("Write frame");
+
+			// Encoded on this thread alone: the render thread needs the shared pool for the next frame, and the pool
+			// runs a second caller serially
+			switch (m_format)
+			{
+			case Format::TGA: frame.buffer->SaveTGAFile(frame.filename.c_str(), false, false); break;
+			case Format::CompressedTGA: frame.buffer->SaveTGAFile(frame.filename.c_str(), true, false); break;
+			case Format::QOI: frame.buffer->SaveQOIFile(frame.filename.c_str(), false); break;
+			}
+		}
+		lock.lock();
+
+		m_writing = false;
+		m_freeBuffers.push_back(frame.buffer);
+		m_bufferFreed.notify_all();
+	}
+}
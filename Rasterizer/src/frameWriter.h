@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+
+// Writes rendered frames to disk on a background thread, so rendering the next frame overlaps with saving the last one.
+// Frames are rendered into buffers owned by the writer: acquire one, draw into it and submit it. A buffer comes back
+// once its frame is written. When every buffer is queued, AcquireBuffer blocks until the writer catches up.
+class FrameWriter
+{
+public:
+	enum class Format
+	{
+		TGA,
+		CompressedTGA, // RLE
+		QOI,
+	};
+
+	// queueLength frames can wait to be written while one more is being rendered
+	FrameWriter(unsigned short width, unsigned short height, Buffer::Layout layout, Format format = Format::TGA, int queueLength = 2);
+	// Writes out every submitted frame before returning
+	~FrameWriter();
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	Buffer& AcquireBuffer();
+	void Submit(Buffer& buffer, const std::string& filename);
+	// Blocks until every submitted frame is written
+	void Flush();
+
+private:
+	struct PendingFrame
+	{
+		Buffer* buffer;
+		std::string filename;
+	};
+
+	void WriterLoop();
+
+	Format m_format;
+	std::vector<std::unique_ptr<Buffer>> m_buffers;
+	std::vector<Buffer*> m_freeBuffers;
+	std::deque<PendingFrame> m_queue;
+	bool m_writing = false;
+	bool m_shutdown = false;
+
+	std::mutex m_mutex;
+	std::condition_variable m_frameQueued;
+	std::condition_variable m_bufferFreed;
+	std::thread m_thread;
+};
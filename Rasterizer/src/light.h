@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cmath>
+#include <limits>
+
 #include "math/float3.h"
 
 struct DirectionalLight
@@ -12,6 +15,16 @@ struct PointLight
 {
 	float3 position;
 	float3 color;
+	// Distance at which the light has faded out, an infinite range lights everything at full strength
+	float range = std::numeric_limits<float>::infinity();
+
+	// Smooth window that is 1 at the light and reaches 0 at the range: (1 - (distance / range)^4)^2
+	float Attenuation(float distance) const
+	{
+		const float ratio = distance / range;
+		const float window = fmax(1.0f - ratio * ratio * ratio * ratio, 0.0f);
+		return window * window;
+	}
 };
 
 struct SpotLight
@@ -0,0 +1,193 @@
+#include "lightClusters.h"
+
+#include "mesh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <initializer_list>
+
+constexpr int LightClusters::TileSize;
+constexpr int LightClusters::DepthSlices;
+constexpr int LightClusters::LaneCount;
+
+int LightClusters::DepthSlice(float viewDepth) const
+{
+	const int slice = (int)(log2f(std::max(viewDepth, Camera::NearPlane) / Camera::NearPlane) * m_sliceScale);
+	return std::min(std::max(slice, 0), DepthSlices - 1);
+}
+
+void LightClusters::Build(const std::vector<PointLight>& lights, const Camera& camera, int width, int height)
+{
+	m_tilesX = (width + TileSize - 1) / TileSize;
+	m_tilesY = (height + TileSize - 1) / TileSize;
+
+	const float aspectRatio = (float)width / height;
+	const float4x4 worldToView = camera.GetViewMatrix();
+	const float4x4 viewToProjection = camera.GetProjectionMatrix(aspectRatio);
+
+	// Projected depth is A + B / viewDepth
+	const float A = viewToProjection.m22;
+	const float B = viewToProjection.m23;
+	m_depthScale = B;
+	m_depthOffset = A;
+	m_sliceScale = DepthSlices / log2f(Camera::FarPlane / Camera::NearPlane);
+
+	const int clusterCount = m_tilesX * m_tilesY * DepthSlices;
+
+	// Pixels along x and y per unit of x / viewDepth and y / viewDepth
+	const float pixelsPerX = 0.5f * width * viewToProjection.m00;
+	const float pixelsPerY = 0.5f * height * viewToProjection.m11;
+
+	// Clusters a light touches, as a tile rectangle per depth slice (max exclusive)
+	struct Footprint
+	{
+		uint32_t light;
+		int slice;
+		int tileXMin, tileXMax, tileYMin, tileYMax;
+	};
+	std::vector<Footprint> footprints;
+
+	for (uint32_t i = 0; i < (uint32_t)lights.size(); i++)
+	{
+		const PointLight& light = lights[i];
+		if (std::isinf(light.range))
+		{
+			for (int slice = 0; slice < DepthSlices; slice++)
+			{
+				footprints.push_back(Footprint{ i, slice, 0, m_tilesX, 0, m_tilesY });
+			}
+			continue;
+		}
+
+		const float3 center = worldToView * light.position;
+		const float radius = light.range;
+		if (center.z + radius < Camera::NearPlane || center.z - radius > Camera::FarPlane || radius <= 0.0f)
+		{
+			continue;
+		}
+
+		const int firstSlice = DepthSlice(center.z - radius);
+		const int lastSlice = DepthSlice(center.z + radius);
+		for (int slice = firstSlice; slice <= lastSlice; slice++)
+		{
+			// Part of the sphere inside the slice, its widest cross section is the one nearest to the center
+			const float sliceNear = Camera::NearPlane * exp2f(slice / m_sliceScale);
+			const float sliceFar = Camera::NearPlane * exp2f((slice + 1) / m_sliceScale);
+			const float zMin = std::max(std::max(sliceNear, center.z - radius), Camera::NearPlane);
+			const float zMax = std::min(slice == DepthSlices - 1 ? Camera::FarPlane : sliceFar, center.z + radius);
+			const float dz = center.z < zMin ? zMin - center.z : (center.z > zMax ? center.z - zMax : 0.0f);
+			const float sectionRadius = sqrtf(std::max(radius * radius - dz * dz, 0.0f));
+
+			// Screen bounds of the box around that part: x / z is extreme at the corners of the box
+			const float xs[2] = { center.x - sectionRadius, center.x + sectionRadius };
+			const float ys[2] = { center.y - sectionRadius, center.y + sectionRadius };
+			float xMin = xs[0] / zMin;
+			float xMax = xMin;
+			float yMin = ys[0] / zMin;
+			float yMax = yMin;
+			for (float z : { zMin, zMax })
+			{
+				for (int corner = 0; corner < 2; corner++)
+				{
+					xMin = std::min(xMin, xs[corner] / z);
+					xMax = std::max(xMax, xs[corner] / z);
+					yMin = std::min(yMin, ys[corner] / z);
+					yMax = std::max(yMax, ys[corner] / z);
+				}
+			}
+
+			// Same pixel mapping as Renderer::ToPixelSpace, a pixel on the edge of the box belongs to both tiles
+			const float pixelXMin = 0.5f * width + xMin * pixelsPerX;
+			const float pixelXMax = 0.5f * width + xMax * pixelsPerX;
+			const float pixelYMin = 0.5f * height + yMin * pixelsPerY;
+			const float pixelYMax = 0.5f * height + yMax * pixelsPerY;
+			if (pixelXMax < 0.0f || pixelYMax < 0.0f || pixelXMin >= width || pixelYMin >= height)
+			{
+				continue;
+			}
+
+			Footprint footprint;
+			footprint.light = i;
+			footprint.slice = slice;
+			footprint.tileXMin = std::max((int)floorf(pixelXMin) / TileSize, 0);
+			footprint.tileXMax = std::min((int)pixelXMax / TileSize + 1, m_tilesX);
+			footprint.tileYMin = std::max((int)floorf(pixelYMin) / TileSize, 0);
+			footprint.tileYMax = std::min((int)pixelYMax / TileSize + 1, m_tilesY);
+			footprints.push_back(footprint);
+		}
+	}
+
+	auto clusterIndex = [&](int tileX, int tileY, int slice) { return (slice * m_tilesY + tileY) * m_tilesX + tileX; };
+
+	// Count, then fill in light order so every cluster lists its lights in ascending order. Clusters are padded to
+	// whole groups of lanes.
+	std::vector<uint32_t> counts(clusterCount, 0);
+	for (const Footprint& footprint : footprints)
+	{
+		for (int tileY = footprint.tileYMin; tileY < footprint.tileYMax; tileY++)
+		{
+			for (int tileX = footprint.tileXMin; tileX < footprint.tileXMax; tileX++)
+			{
+				counts[clusterIndex(tileX, tileY, footprint.slice)]++;
+			}
+		}
+	}
+	m_offsets.resize(clusterCount + 1);
+	m_offsets[0] = 0;
+	for (int i = 0; i < clusterCount; i++)
+	{
+		m_offsets[i + 1] = m_offsets[i] + (counts[i] + LaneCount - 1) / LaneCount * LaneCount;
+	}
+
+	// Padding is a black light at the origin
+	const size_t entries = m_offsets[clusterCount];
+	for (Array* array : { &m_positionX, &m_positionY, &m_positionZ, &m_colorR, &m_colorG, &m_colorB, &m_inverseRangeSquared })
+	{
+		array->assign(entries, 0.0f);
+	}
+
+	std::vector<uint32_t> next(m_offsets.begin(), m_offsets.end() - 1);
+	for (const Footprint& footprint : footprints)
+	{
+		const PointLight& light = lights[footprint.light];
+		const float inverseRangeSquared = std::isinf(light.range) ? 0.0f : 1.0f / (light.range * light.range);
+		for (int tileY = footprint.tileYMin; tileY < footprint.tileYMax; tileY++)
+		{
+			for (int tileX = footprint.tileXMin; tileX < footprint.tileXMax; tileX++)
+			{
+				const uint32_t entry = next[clusterIndex(tileX, tileY, footprint.slice)]++;
+				m_positionX[entry] = light.position.x;
+				m_positionY[entry] = light.position.y;
+				m_positionZ[entry] = light.position.z;
+				m_colorR[entry] = light.color.r;
+				m_colorG[entry] = light.color.g;
+				m_colorB[entry] = light.color.b;
+				m_inverseRangeSquared[entry] = inverseRangeSquared;
+			}
+		}
+	}
+}
+
+LightClusters::Lights LightClusters::At(int x, int y, float depth) const
+{
+	assert(m_offsets.empty() == false && "Build was not called");
+
+	const int tileX = std::min(std::max(x / TileSize, 0), m_tilesX - 1);
+	const int tileY = std::min(std::max(y / TileSize, 0), m_tilesY - 1);
+	const float viewDepth = m_depthScale / (depth - m_depthOffset);
+	const int cluster = (DepthSlice(viewDepth) * m_tilesY + tileY) * m_tilesX + tileX;
+
+	const uint32_t offset = m_offsets[cluster];
+
+	Lights result;
+	result.positionX = m_positionX.data() + offset;
+	result.positionY = m_positionY.data() + offset;
+	result.positionZ = m_positionZ.data() + offset;
+	result.colorR = m_colorR.data() + offset;
+	result.colorG = m_colorG.data() + offset;
+	result.colorB = m_colorB.data() + offset;
+	result.inverseRangeSquared = m_inverseRangeSquared.data() + offset;
+	result.count = (int)(m_offsets[cluster + 1] - offset);
+	return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "alignedAllocator.h"
+#include "light.h"
+#include "math/float4x4.h"
+
+struct Camera;
+
+// Point lights sorted into clusters of the view frustum: screen tiles times depth slices. A pixel only evaluates
+// the lights whose range overlaps its cluster, so the cost per pixel depends on the lights around it and not
+// on the number of lights in the scene. Lights with an infinite range are in every cluster.
+class LightClusters
+{
+public:
+	static constexpr int TileSize = 32;
+	// Exponentially spaced between the near and the far plane, so slices get longer with the distance like the tiles do
+	static constexpr int DepthSlices = 16;
+
+	// Lights are evaluated this many at a time
+	static constexpr int LaneCount = 4;
+
+	// The lights of a cluster as structure of arrays, in ascending light order. Every array starts 16 byte aligned and
+	// count is a multiple of LaneCount, the lights added to fill the last group are black and have an infinite range.
+	struct Lights
+	{
+		const float* positionX;
+		const float* positionY;
+		const float* positionZ;
+		const float* colorR;
+		const float* colorG;
+		const float* colorB;
+		const float* inverseRangeSquared; // 0 for an infinite range
+		int count;
+	};
+
+	void Build(const std::vector<PointLight>& lights, const Camera& camera, int width, int height);
+
+	// Lights of the cluster containing pixel (x, y) at the given depth after perspective division
+	Lights At(int x, int y, float depth) const;
+
+	// True if no light reaches the screen
+	bool Empty() const { return m_offsets.empty() || m_offsets.back() == 0; }
+
+private:
+	int DepthSlice(float viewDepth) const;
+
+	int m_tilesX = 0;
+	int m_tilesY = 0;
+	// Converts depth after perspective division back to view space: viewDepth = m_depthScale / (depth - m_depthOffset)
+	float m_depthScale = 0.0f;
+	float m_depthOffset = 0.0f;
+	float m_sliceScale = 0.0f; // slices per log2 unit of view depth
+
+	// Lights of cluster i are entries m_offsets[i] to m_offsets[i + 1] (exclusive) of the arrays, copied per cluster
+	// so a cluster is read front to back
+	typedef std::vector<float, AlignedAllocator<float, 16>> Array;
+	std::vector<uint32_t> m_offsets;
+	Array m_positionX;
+	Array m_positionY;
+	Array m_positionZ;
+	Array m_colorR;
+	Array m_colorG;
+	Array m_colorB;
+	Array m_inverseRangeSquared;
+};
@@ -5,25 +5,115 @@
 #include "math/float4x4.h"
 #include "meshBuilder.h"
 #include "light.h"
+#include "texture.h"
+#include "frameWriter.h"
+#include "frameStream.h"
+#include "sharedFrameRing.h"
+#include "profiler.h"
 
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <math.h>
 #include <vector>
 
-int main()
+int main(int argc, char** argv)
 {
-	Buffer buffer{ 500, 400 };
+	// Each mode renders N frames of an orbit around the scene:
+	//   "--sequence N [qoi|tga|rle]" into frame_0000.qoi, frame_0001.qoi, ...
+	//   "--stream N [y4m|bgra]" to stdout, e.g. piped into a video encoder
+	//   "--shm N [name]" into a shared memory ring (see SharedFrameRing) another process can map
+	// Without a mode, image.tga is rendered. "--stats" prints its pipeline statistics, "--overdraw" also saves
+	// overdraw.tga, a heatmap of how many times each pixel was shaded.
+	// "--trace file.json" records a trace of any mode, see Profiler.
+	enum class Output { Image, Sequence, Stream, SharedMemory };
+	Output output = Output::Image;
+	int sequenceLength = 0;
+	FrameWriter::Format format = FrameWriter::Format::QOI;
+	const char* extension = "qoi";
+	FrameStream::Format streamFormat = FrameStream::Format::Y4M;
+	const char* sharedMemoryName = "/rasterizer";
+	if (argc >= 3 && strcmp(argv[1], "--sequence") == 0)
+	{
+		output = Output::Sequence;
+		sequenceLength = atoi(argv[2]);
+		if (argc >= 4 && strcmp(argv[3], "tga") == 0)
+		{
+			format = FrameWriter::Format::TGA;
+			extension = "tga";
+		}
+		else if (argc >= 4 && strcmp(argv[3], "rle") == 0)
+		{
+			format = FrameWriter::Format::CompressedTGA;
+			extension = "tga";
+		}
+	}
+	else if (argc >= 3 && strcmp(argv[1], "--stream") == 0)
+	{
+		output = Output::Stream;
+		sequenceLength = atoi(argv[2]);
+		if (argc >= 4 && strcmp(argv[3], "bgra") == 0)
+		{
+			streamFormat = FrameStream::Format::RawBGRA;
+		}
+	}
+	else if (argc >= 3 && strcmp(argv[1], "--shm") == 0)
+	{
+		output = Output::SharedMemory;
+		sequenceLength = atoi(argv[2]);
+		if (argc >= 4)
+		{
+			sharedMemoryName = argv[3];
+		}
+	}
+
+	bool printStatistics = false;
+	bool saveOverdraw = false;
+	const char* traceFilename = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		printStatistics |= strcmp(argv[i], "--stats") == 0;
+		saveOverdraw |= strcmp(argv[i], "--overdraw") == 0;
+		if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			traceFilename = argv[i + 1];
+		}
+	}
+
+	Profiler::SetThreadName("Main");
+	if (traceFilename != nullptr)
+	{
+		Profiler::Start();
+	}
+	auto writeTrace = [&]()
+	{
+		if (traceFilename != nullptr)
+		{
+			Profiler::Stop();
+			if (Profiler::WriteTrace(traceFilename) == false)
+			{
+				fprintf(stderr, "couldn't write %s\n", traceFilename);
+			}
+		}
+	};
+
+	Buffer buffer{ 500, 400, Buffer::Layout::Tiled };
 	buffer.ClearColor(0xff000000); // ARGB
+	buffer.ClearDepth();
 
 	Camera camera{ float3(0, 2, 7), float3(0, 0, 0) };
 
-	Buffer earthTexture(1,1);
-	earthTexture.ReadTGAFromFile("res/earth.tga");
-	assert(earthTexture.GetWidth() != 1 && "earth texture didn't load coorrectly");
+	Buffer earthImage(1,1);
+	earthImage.ReadTGAFromFile("res/earth.tga");
+	assert(earthImage.GetWidth() != 1 && "earth texture didn't load coorrectly");
+	Texture earthTexture(earthImage);
 
-	Buffer brickTexture(1,1);
-	brickTexture.ReadTGAFromFile("res/bricks.tga");
-	assert(brickTexture.GetWidth() != 1 && "bricks texture didn't load coorrectly");
+	Buffer brickImage(1,1);
+	brickImage.ReadTGAFromFile("res/bricks.tga");
+	assert(brickImage.GetWidth() != 1 && "bricks texture didn't load coorrectly");
+	Texture brickTexture(brickImage);
 
 	Mesh sphere = MeshBuilder::BuildUnitSphere(100);
 	sphere.texture = &earthTexture;
@@ -51,13 +141,108 @@ int main()
 	Transform lightSphereTransform{ pointLights[0].position, float3(0, 0, 0), float3(0.1f, 0.1f, 0.1f) };
 	lightSphere.SetColor(float3(1, 1, 1));
 
-	Renderer::DrawMesh(buffer, sphere, sphereTransform, camera, directionalLight, pointLights, spotLight);
-	Renderer::DrawMesh(buffer, sphere, bigSphereTransform, camera, directionalLight, pointLights, spotLight);
-	Renderer::DrawMesh(buffer, torus, torusTransform, camera, directionalLight, pointLights, spotLight);
-	Renderer::DrawMesh(buffer, lightSphere, lightSphereTransform, camera, directionalLight, pointLights, spotLight);
-	Renderer::DrawMesh(buffer, cube, cubeTransform, camera, directionalLight, pointLights, spotLight);
+	auto submitScene = [&](Renderer::Frame& frame)
+	{
+		frame.depthPrepass = true; // resolve visibility first, then shade every pixel once
+
+		frame.Submit(sphere, sphereTransform);
+		frame.Submit(sphere, bigSphereTransform);
+		frame.Submit(torus, torusTransform);
+		frame.Submit(lightSphere, lightSphereTransform);
+		frame.Submit(cube, cubeTransform);
+	};
+
+	if (output == Output::Image || sequenceLength <= 0)
+	{
+		Renderer::Statistics statistics;
+		Renderer::Frame frame(camera, directionalLight, pointLights, spotLight);
+		if (printStatistics || saveOverdraw)
+		{
+			frame.statistics = &statistics;
+		}
+		submitScene(frame);
+		Renderer::Flush(buffer, frame);
+
+		buffer.SaveTGAFile("image.tga");
+
+		if (printStatistics || saveOverdraw)
+		{
+			statistics.Print(stdout);
+		}
+		if (saveOverdraw)
+		{
+			Buffer heatmap{ buffer.GetWidth(), buffer.GetHeight() };
+			statistics.WriteHeatmap(heatmap);
+			heatmap.SaveTGAFile("overdraw.tga");
+		}
+
+		writeTrace();
+		return 0;
+	}
+
+	auto renderOrbitFrame = [&](Buffer& frameBuffer, int i)
+	{
+		const float angle = 2.0f * (float)M_PI * i / sequenceLength;
+		Camera orbitCamera{ float3(sinf(angle) * 7.0f, 2.0f, cosf(angle) * 7.0f), camera.target };
+
+		frameBuffer.ClearColor(0xff000000);
+		frameBuffer.ClearDepth();
+
+		Renderer::Frame frame(orbitCamera, directionalLight, pointLights, spotLight);
+		submitScene(frame);
+		Renderer::Flush(frameBuffer, frame);
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	if (output == Output::Sequence)
+	{
+		// Frames are written on a background thread while the next ones render
+		FrameWriter writer(buffer.GetWidth(), buffer.GetHeight(), Buffer::Layout::Tiled, format);
+		for (int i = 0; i < sequenceLength; i++)
+		{
+			Buffer& frameBuffer = writer.AcquireBuffer();
+			renderOrbitFrame(frameBuffer, i);
+
+			char filename[32];
+			snprintf(filename, sizeof(filename), "frame_%04d.%s", i, extension);
+			writer.Submit(frameBuffer, filename);
+		}
+		writer.Flush();
+	}
+	else if (output == Output::Stream)
+	{
+		// A linear buffer lets the rows go to stdout without being resolved first
+		Buffer frameBuffer{ buffer.GetWidth(), buffer.GetHeight(), Buffer::Layout::Linear };
+		FrameStream stream(stdout, streamFormat, frameBuffer.GetWidth(), frameBuffer.GetHeight());
+		for (int i = 0; i < sequenceLength; i++)
+		{
+			renderOrbitFrame(frameBuffer, i);
+			if (stream.Write(frameBuffer) == false)
+			{
+				fprintf(stderr, "writing frame %d failed\n", i);
+				return 1;
+			}
+		}
+	}
+	else
+	{
+		SharedFrameRing ring(sharedMemoryName, buffer.GetWidth(), buffer.GetHeight());
+		if (ring.IsOpen() == false)
+		{
+			fprintf(stderr, "couldn't create shared memory %s\n", sharedMemoryName);
+			return 1;
+		}
+		for (int i = 0; i < sequenceLength; i++)
+		{
+			renderOrbitFrame(ring.AcquireBuffer(), i);
+			ring.Publish();
+		}
+	}
 
-	buffer.SaveTGAFile("image.tga");
+	// stdout might carry the frames
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stderr, "%d frames in %.2f s, %.1f fps\n", sequenceLength, seconds, sequenceLength / seconds);
 
+	writeTrace();
 	return 0;
 }
@@ -0,0 +1,91 @@
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char* filename)
+{
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size) == FALSE || size.QuadPart == 0)
+	{
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		return;
+	}
+	m_mapping = mapping;
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	m_size = m_data != nullptr ? (size_t)size.QuadPart : 0;
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data != nullptr)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != nullptr)
+	{
+		CloseHandle(m_mapping);
+	}
+	if (m_file != nullptr)
+	{
+		CloseHandle(m_file);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(const char* filename)
+{
+	const int file = open(filename, O_RDONLY);
+	if (file < 0)
+	{
+		return;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+	{
+		void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data != MAP_FAILED)
+		{
+			m_data = static_cast<const uint8_t*>(data);
+			m_size = (size_t)status.st_size;
+		}
+	}
+
+	// The mapping stays valid after the descriptor is closed
+	close(file);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data != nullptr)
+	{
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+}
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of a whole file, mapped into memory instead of copied into a buffer
+class MappedFile
+{
+public:
+	explicit MappedFile(const char* filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// False when the file could not be opened or is empty
+	bool IsOpen() const { return m_data != nullptr; }
+	const uint8_t* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
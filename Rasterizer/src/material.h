@@ -0,0 +1,10 @@
+#pragma once
+
+#include "math/float3.h"
+
+struct Material
+{
+	float3 ambient = float3(0.1f, 0.1f, 0.1f);
+	float specularIntensity = 1.0f;
+	float specularExponent = 32.0f;
+};
@@ -1,12 +1,18 @@
 #pragma once
 
+#ifndef _USE_MATH_DEFINES
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+#include <cassert>
+#include <iostream>
 #include <ostream>
 
-struct float3 
+struct float3
 {
-    float3();
-    float3(float x, float y, float z);
-    float3(const struct float4& other);
+    constexpr float3() : x(0), y(0), z(0) {}
+    constexpr float3(float x, float y, float z) : x(x), y(y), z(z) {}
+    constexpr float3(const struct float4& other);
 
     union
     {
@@ -25,14 +31,14 @@ struct float3
         };
     };
 
-    float3 operator+(const float3& other) const;
-    float3 operator-(const float3& other) const;
-    float3 operator*(const float3& other) const;
-    float3 operator*(float scalar) const;
-    float3 operator/(float scalar) const;
+    constexpr float3 operator+(const float3& other) const { return float3(x + other.x, y + other.y, z + other.z); }
+    constexpr float3 operator-(const float3& other) const { return float3(x - other.x, y - other.y, z - other.z); }
+    constexpr float3 operator*(const float3& other) const { return float3(x * other.x, y * other.y, z * other.z); }
+    constexpr float3 operator*(float scalar) const { return float3(x * scalar, y * scalar, z * scalar); }
+    constexpr float3 operator/(float scalar) const { return float3(x / scalar, y / scalar, z / scalar); }
     float3& operator+=(const float3& other);
 
-    friend float3 operator-(const float3& other);
+    friend constexpr float3 operator-(const float3& other) { return float3(-other.x, -other.y, -other.z); }
 
     void Normalize();
     float3 Normalized() const;
@@ -42,10 +48,116 @@ struct float3
     float Magnitude() const;
 
     static float3 Reflect(const float3& incident, const float3& normal);
-    static float Dot(const float3& a, const float3& b);
-    static float3 Cross(const float3& a, const float3& b);
+    static constexpr float Dot(const float3& a, const float3& b) { return (a.x * b.x) + (a.y * b.y) + (a.z * b.z); }
+    static constexpr float3 Cross(const float3& a, const float3& b);
     static float AngleRad(const float3& a, const float3& b);
     static float AngleDeg(const float3& a, const float3& b);
 
     friend std::ostream& operator<<(std::ostream& os, const float3& v);
-};
\ No newline at end of file
+};
+
+inline float3& float3::operator+=(const float3& other)
+{
+    x += other.x;
+    y += other.y;
+    z += other.z;
+
+    return *this;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const float3& v)
+{
+    os << '(' << v.x << ", " << v.y << ", " << v.z << ')';
+
+    return os;
+}
+
+inline void float3::Normalize()
+{
+    const float mag = Magnitude();
+    assert(mag != 0);
+    x /= mag;
+    y /= mag;
+    z /= mag;
+}
+
+inline float3 float3::Normalized() const
+{
+    float3 normalized = *this;
+    normalized.Normalize();
+
+    return normalized;
+}
+
+inline float float3::Magnitude() const
+{
+    float tmp = x*x + y*y + z*z;
+    assert(tmp >= 0);
+
+    // stderr: stdout may be carrying frames, see --stream
+    if (tmp == 0)
+    {
+        std::cerr << "magnitude called on 0 vector, make sure it's not a mistake!\n";
+    }
+
+    return sqrt(tmp);
+}
+
+inline bool float3::IsNormalized() const
+{
+    return Magnitude() - 1.0f < 0.0001f;
+}
+
+inline void float3::Clamp(float min, float max)
+{
+    x = fmin(fmax(x, min), max);
+    y = fmin(fmax(y, min), max);
+    z = fmin(fmax(z, min), max);
+}
+
+inline float3 float3::Clamped(float min, float max) const
+{
+    float3 copy = *this;
+    copy.Clamp(min, max);
+
+    return copy;
+}
+
+inline float3 float3::Reflect(const float3& incident, const float3& normal)
+{
+    float3 n = normal.Normalized();
+    return incident - n * (2.0f * float3::Dot(incident, n));
+}
+
+constexpr float3 float3::Cross(const float3& a, const float3& b)
+{
+    // TODO : apparently this was wrong??? but why cross product of (0, -0.707, 0.707) and (0, 1, 0) is (-1, 0, 0) and not (1, 0, 0)???
+    //return float3(
+    //    (a.y * b.z) - (a.z * b.y),
+    //    (a.x * b.z) - (a.z * b.x), // these operands are flipped, so that it works in left handed coorinate system... I think?
+    //    (a.x * b.y) - (a.y * b.x)
+    //);
+
+    // TODO : aparently, the handedness of coordinate system doesn't matter? https://stackoverflow.com/questions/4820400/does-the-method-for-computing-the-cross-product-change-for-left-handed-coordinat
+    // This is given for right hand. but accoring to one comment in the left hand it's flipped. (makes sense if you wave the hand in the air)
+    //
+    // For right handed
+    return float3(
+        (a.y * b.z) - (a.z * b.y),
+        (a.z * b.x) - (a.x * b.z),
+        (a.x * b.y) - (a.y * b.x)
+    );
+}
+
+inline float float3::AngleRad(const float3& a, const float3& b)
+{
+    return acos(float3::Dot(a, b) / (a.Magnitude() * b.Magnitude()));
+}
+
+inline float float3::AngleDeg(const float3& a, const float3& b)
+{
+    return AngleRad(a, b) * (float)(180.0 / M_PI);
+}
+
+// float3(const float4&) is defined there, once float4 is complete
+#include "float4.h"
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <math.h>
+#include <cassert>
 #include <ostream>
 
 #include "float3.h"
+#include "simd.h"
 
 struct float4
 {
@@ -35,7 +38,109 @@ struct float4
     float Magnitude() const;
     bool IsNormalized() const;
 
-    static float Dot(const float4& a, const float4& b);
+    static constexpr float Dot(const float4& a, const float4& b) { return (a.x * b.x) + (a.y * b.y) + (a.z * b.z) + (a.w * b.w); }
 
     friend std::ostream& operator<<(std::ostream& os, const float4& v);
-};
\ No newline at end of file
+};
+
+constexpr float3::float3(const float4& other)
+    : x(other.x), y(other.y), z(other.z)
+{
+}
+
+inline float4 float4::operator+(const float4& other) const
+{
+#if RASTERIZER_MATH_SSE
+    float4 result;
+    _mm_storeu_ps(&result.x, _mm_add_ps(_mm_loadu_ps(&x), _mm_loadu_ps(&other.x)));
+    return result;
+#elif RASTERIZER_MATH_NEON
+    float4 result;
+    vst1q_f32(&result.x, vaddq_f32(vld1q_f32(&x), vld1q_f32(&other.x)));
+    return result;
+#else
+    return float4{ x + other.x, y + other.y, z + other.z, w + other.w };
+#endif
+}
+
+inline float4 float4::operator-(const float4& other) const
+{
+#if RASTERIZER_MATH_SSE
+    float4 result;
+    _mm_storeu_ps(&result.x, _mm_sub_ps(_mm_loadu_ps(&x), _mm_loadu_ps(&other.x)));
+    return result;
+#elif RASTERIZER_MATH_NEON
+    float4 result;
+    vst1q_f32(&result.x, vsubq_f32(vld1q_f32(&x), vld1q_f32(&other.x)));
+    return result;
+#else
+    return float4{ x - other.x, y - other.y, z - other.z, w - other.w };
+#endif
+}
+
+inline float4 float4::operator*(float scalar) const
+{
+#if RASTERIZER_MATH_SSE
+    float4 result;
+    _mm_storeu_ps(&result.x, _mm_mul_ps(_mm_loadu_ps(&x), _mm_set1_ps(scalar)));
+    return result;
+#elif RASTERIZER_MATH_NEON
+    float4 result;
+    vst1q_f32(&result.x, vmulq_n_f32(vld1q_f32(&x), scalar));
+    return result;
+#else
+    return float4{ x * scalar, y * scalar, z * scalar, w * scalar };
+#endif
+}
+
+inline float4 float4::operator/(float scalar) const
+{
+#if RASTERIZER_MATH_SSE
+    float4 result;
+    _mm_storeu_ps(&result.x, _mm_div_ps(_mm_loadu_ps(&x), _mm_set1_ps(scalar)));
+    return result;
+#elif RASTERIZER_MATH_NEON
+    float4 result;
+    vst1q_f32(&result.x, vdivq_f32(vld1q_f32(&x), vdupq_n_f32(scalar)));
+    return result;
+#else
+    return float4{ x / scalar, y / scalar, z / scalar, w / scalar };
+#endif
+}
+
+inline std::ostream& operator<<(std::ostream& os, const float4& v)
+{
+    os << '(' << v.x << ", " << v.y << ", " << v.z << ", " << v.w << ')';
+
+    return os;
+}
+
+inline void float4::Normalize()
+{
+    const float mag = Magnitude();
+    x /= mag;
+    y /= mag;
+    z /= mag;
+    w /= mag;
+}
+
+inline float4 float4::Normalized() const
+{
+    float4 normalized = *this;
+    normalized.Normalize();
+
+    return normalized;
+}
+
+inline float float4::Magnitude() const
+{
+    float tmp = x * x + y * y + z * z + w * w;
+    assert(tmp > 0);
+
+    return sqrt(tmp);
+}
+
+inline bool float4::IsNormalized() const
+{
+    return Magnitude() - 1.0f < 0.0001f;
+}
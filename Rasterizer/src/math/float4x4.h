@@ -1,15 +1,26 @@
 #pragma once
 
+#include <math.h>
+#include <cassert>
+
 #include "float3.h"
 #include "float4.h"
+#include "simd.h"
 
 struct float4x4 
 {
-	float4x4();
-	float4x4(	float m00, float m01, float m02, float m03,
-				float m10, float m11, float m12, float m13,
-				float m20, float m21, float m22, float m23,
-				float m30, float m31, float m32, float m33);
+	constexpr float4x4()
+		: m00(0), m01(0), m02(0), m03(0), m10(0), m11(0), m12(0), m13(0), m20(0), m21(0), m22(0), m23(0), m30(0), m31(0), m32(0), m33(0)
+	{
+	}
+
+	constexpr float4x4(	float m00, float m01, float m02, float m03,
+						float m10, float m11, float m12, float m13,
+						float m20, float m21, float m22, float m23,
+						float m30, float m31, float m32, float m33)
+		: m00(m00), m01(m01), m02(m02), m03(m03), m10(m10), m11(m11), m12(m12), m13(m13), m20(m20), m21(m21), m22(m22), m23(m23), m30(m30), m31(m31), m32(m32), m33(m33)
+	{
+	}
 
 	union
 	{
@@ -33,15 +44,260 @@ struct float4x4
 	float4x4 operator*(const float4x4& other) const;
 	float4 operator*(const float4& vector) const;
 	float4 operator*(const float3& vector) const;
-	float4x4 operator*(float scalar) const;
+	constexpr float4x4 operator*(float scalar) const;
 
 	void Transpose();
+	constexpr float4x4 Transposed() const;
+	float4x4 Inverse() const;
 
-	static float4x4 Translate(float3 translation);
+	static constexpr float4x4 Translate(float3 translation);
 	static float4x4 Rotate(float angle, float3 axis);
-	static float4x4 Scale(float3 scale);
+	static constexpr float4x4 Scale(float3 scale);
 
-	static float4x4 Identity();
+	static constexpr float4x4 Identity();
 	static float4x4 Perspective(float fovy, float aspect, float near, float far);
 	static float4x4 LookAt(float3 eye, float3 target, float3 up);
-};
\ No newline at end of file
+};
+
+// The vector versions sum the four products in the same order as the scalar ones, so the results are identical
+inline float4x4 float4x4::operator*(const float4x4& other) const
+{
+	float4x4 result;
+
+#if RASTERIZER_MATH_SSE
+	const __m128 otherRow0 = _mm_loadu_ps(&other.m00);
+	const __m128 otherRow1 = _mm_loadu_ps(&other.m10);
+	const __m128 otherRow2 = _mm_loadu_ps(&other.m20);
+	const __m128 otherRow3 = _mm_loadu_ps(&other.m30);
+	const float* rows[4] = { &m00, &m10, &m20, &m30 };
+	float* resultRows[4] = { &result.m00, &result.m10, &result.m20, &result.m30 };
+	for (int i = 0; i < 4; i++)
+	{
+		const float* row = rows[i];
+		__m128 sum = _mm_mul_ps(_mm_set1_ps(row[0]), otherRow0);
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(row[1]), otherRow1));
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(row[2]), otherRow2));
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(row[3]), otherRow3));
+		_mm_storeu_ps(resultRows[i], sum);
+	}
+#elif RASTERIZER_MATH_NEON
+	const float32x4_t otherRow0 = vld1q_f32(&other.m00);
+	const float32x4_t otherRow1 = vld1q_f32(&other.m10);
+	const float32x4_t otherRow2 = vld1q_f32(&other.m20);
+	const float32x4_t otherRow3 = vld1q_f32(&other.m30);
+	const float* rows[4] = { &m00, &m10, &m20, &m30 };
+	float* resultRows[4] = { &result.m00, &result.m10, &result.m20, &result.m30 };
+	for (int i = 0; i < 4; i++)
+	{
+		const float* row = rows[i];
+		float32x4_t sum = vmulq_n_f32(otherRow0, row[0]);
+		sum = vaddq_f32(sum, vmulq_n_f32(otherRow1, row[1]));
+		sum = vaddq_f32(sum, vmulq_n_f32(otherRow2, row[2]));
+		sum = vaddq_f32(sum, vmulq_n_f32(otherRow3, row[3]));
+		vst1q_f32(resultRows[i], sum);
+	}
+#else
+	result.m00 = m00 * other.m00 + m01 * other.m10 + m02 * other.m20 + m03 * other.m30;
+	result.m01 = m00 * other.m01 + m01 * other.m11 + m02 * other.m21 + m03 * other.m31;
+	result.m02 = m00 * other.m02 + m01 * other.m12 + m02 * other.m22 + m03 * other.m32;
+	result.m03 = m00 * other.m03 + m01 * other.m13 + m02 * other.m23 + m03 * other.m33;
+
+	result.m10 = m10 * other.m00 + m11 * other.m10 + m12 * other.m20 + m13 * other.m30;
+	result.m11 = m10 * other.m01 + m11 * other.m11 + m12 * other.m21 + m13 * other.m31;
+	result.m12 = m10 * other.m02 + m11 * other.m12 + m12 * other.m22 + m13 * other.m32;
+	result.m13 = m10 * other.m03 + m11 * other.m13 + m12 * other.m23 + m13 * other.m33;
+
+	result.m20 = m20 * other.m00 + m21 * other.m10 + m22 * other.m20 + m23 * other.m30;
+	result.m21 = m20 * other.m01 + m21 * other.m11 + m22 * other.m21 + m23 * other.m31;
+	result.m22 = m20 * other.m02 + m21 * other.m12 + m22 * other.m22 + m23 * other.m32;
+	result.m23 = m20 * other.m03 + m21 * other.m13 + m22 * other.m23 + m23 * other.m33;
+
+	result.m30 = m30 * other.m00 + m31 * other.m10 + m32 * other.m20 + m33 * other.m30;
+	result.m31 = m30 * other.m01 + m31 * other.m11 + m32 * other.m21 + m33 * other.m31;
+	result.m32 = m30 * other.m02 + m31 * other.m12 + m32 * other.m22 + m33 * other.m32;
+	result.m33 = m30 * other.m03 + m31 * other.m13 + m32 * other.m23 + m33 * other.m33;
+#endif
+
+	return result;
+}
+
+inline float4 float4x4::operator*(const float4& vector) const
+{
+	float4 result;
+
+#if RASTERIZER_MATH_SSE
+	// Columns of the matrix, scaled by the vector components and summed
+	__m128 column0 = _mm_loadu_ps(&m00);
+	__m128 column1 = _mm_loadu_ps(&m10);
+	__m128 column2 = _mm_loadu_ps(&m20);
+	__m128 column3 = _mm_loadu_ps(&m30);
+	_MM_TRANSPOSE4_PS(column0, column1, column2, column3);
+	__m128 sum = _mm_mul_ps(column0, _mm_set1_ps(vector.x));
+	sum = _mm_add_ps(sum, _mm_mul_ps(column1, _mm_set1_ps(vector.y)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(column2, _mm_set1_ps(vector.z)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(column3, _mm_set1_ps(vector.w)));
+	_mm_storeu_ps(&result.x, sum);
+#elif RASTERIZER_MATH_NEON
+	const float32x4x4_t columns = vld4q_f32(&m00);
+	float32x4_t sum = vmulq_n_f32(columns.val[0], vector.x);
+	sum = vaddq_f32(sum, vmulq_n_f32(columns.val[1], vector.y));
+	sum = vaddq_f32(sum, vmulq_n_f32(columns.val[2], vector.z));
+	sum = vaddq_f32(sum, vmulq_n_f32(columns.val[3], vector.w));
+	vst1q_f32(&result.x, sum);
+#else
+	result.x = m00 * vector.x + m01 * vector.y + m02 * vector.z + m03 * vector.w;
+	result.y = m10 * vector.x + m11 * vector.y + m12 * vector.z + m13 * vector.w;
+	result.z = m20 * vector.x + m21 * vector.y + m22 * vector.z + m23 * vector.w;
+	result.w = m30 * vector.x + m31 * vector.y + m32 * vector.z + m33 * vector.w;
+#endif
+
+	return result;
+}
+
+inline float4 float4x4::operator*(const float3& vector) const
+{
+	return (*this) * float4{ vector.x, vector.y, vector.z, 1.0f };
+}
+
+constexpr float4x4 float4x4::operator*(float scalar) const
+{
+	return float4x4(
+		m00 * scalar, m01 * scalar, m02 * scalar, m03 * scalar,
+		m10 * scalar, m11 * scalar, m12 * scalar, m13 * scalar,
+		m20 * scalar, m21 * scalar, m22 * scalar, m23 * scalar,
+		m30 * scalar, m31 * scalar, m32 * scalar, m33 * scalar);
+}
+
+inline void float4x4::Transpose()
+{
+	*this = Transposed();
+}
+
+constexpr float4x4 float4x4::Transposed() const
+{
+	return float4x4(
+		m00, m10, m20, m30,
+		m01, m11, m21, m31,
+		m02, m12, m22, m32,
+		m03, m13, m23, m33);
+}
+
+inline float4x4 float4x4::Inverse() const
+{
+	// Cofactor expansion using the 2x2 sub-determinants of the top and bottom two rows
+	const float s0 = m00 * m11 - m10 * m01;
+	const float s1 = m00 * m12 - m10 * m02;
+	const float s2 = m00 * m13 - m10 * m03;
+	const float s3 = m01 * m12 - m11 * m02;
+	const float s4 = m01 * m13 - m11 * m03;
+	const float s5 = m02 * m13 - m12 * m03;
+
+	const float c5 = m22 * m33 - m32 * m23;
+	const float c4 = m21 * m33 - m31 * m23;
+	const float c3 = m21 * m32 - m31 * m22;
+	const float c2 = m20 * m33 - m30 * m23;
+	const float c1 = m20 * m32 - m30 * m22;
+	const float c0 = m20 * m31 - m30 * m21;
+
+	const float determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	assert(determinant != 0 && "matrix is not invertible");
+	const float invDet = 1.0f / determinant;
+
+	return float4x4(
+		( m11 * c5 - m12 * c4 + m13 * c3) * invDet,
+		(-m01 * c5 + m02 * c4 - m03 * c3) * invDet,
+		( m31 * s5 - m32 * s4 + m33 * s3) * invDet,
+		(-m21 * s5 + m22 * s4 - m23 * s3) * invDet,
+
+		(-m10 * c5 + m12 * c2 - m13 * c1) * invDet,
+		( m00 * c5 - m02 * c2 + m03 * c1) * invDet,
+		(-m30 * s5 + m32 * s2 - m33 * s1) * invDet,
+		( m20 * s5 - m22 * s2 + m23 * s1) * invDet,
+
+		( m10 * c4 - m11 * c2 + m13 * c0) * invDet,
+		(-m00 * c4 + m01 * c2 - m03 * c0) * invDet,
+		( m30 * s4 - m31 * s2 + m33 * s0) * invDet,
+		(-m20 * s4 + m21 * s2 - m23 * s0) * invDet,
+
+		(-m10 * c3 + m11 * c1 - m12 * c0) * invDet,
+		( m00 * c3 - m01 * c1 + m02 * c0) * invDet,
+		(-m30 * s3 + m31 * s1 - m32 * s0) * invDet,
+		( m20 * s3 - m21 * s1 + m22 * s0) * invDet
+	);
+}
+
+constexpr float4x4 float4x4::Translate(float3 translation)
+{
+	return float4x4(
+		1, 0, 0, translation.x,
+		0, 1, 0, translation.y,
+		0, 0, 1, translation.z,
+		0, 0, 0, 1);
+}
+
+inline float4x4 float4x4::Rotate(float angle, float3 axis)
+{
+	const float s = sinf(angle * (float)M_PI / 180.0f);
+	const float c = cosf(angle * (float)M_PI / 180.0f);
+	
+	axis.Normalize();
+
+	float4x4 result = float4x4::Identity();
+	result.row0 = float4{axis.x * axis.x * (1 - c) + c, axis.y * axis.x * (1 - c) + axis.z * s, axis.x * axis.z * (1 - c) - axis.y * s, 0};
+	result.row1 = float4{axis.x * axis.y * (1 - c) - axis.z * s, axis.y * axis.y * (1 - c) + c, axis.y * axis.z * (1 - c) + axis.x * s, 0};
+	result.row2 = float4{axis.x * axis.z * (1 - c) + axis.y * s, axis.y * axis.z * (1 - c) - axis.x * s, axis.z * axis.z * (1 - c) + c, 0};
+	result.row3 = float4{0, 0, 0, 1};
+
+	return result;
+}
+
+constexpr float4x4 float4x4::Scale(float3 scale)
+{
+	return float4x4(
+		scale.x, 0, 0, 0,
+		0, scale.y, 0, 0,
+		0, 0, scale.z, 0,
+		0, 0, 0, 1);
+}
+
+constexpr float4x4 float4x4::Identity()
+{
+	return float4x4(
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		0, 0, 0, 1);
+}
+
+inline float4x4 float4x4::Perspective(float fovy, float aspect, float near, float far)
+{
+	fovy *= (float)M_PI / 360.0f; // FOVy/2
+	float f = cos(fovy) / sin(fovy);
+
+	float4x4 view2proj;
+
+	view2proj.row0 = float4{f / aspect, 0, 0, 0};
+	view2proj.row1 = float4{0, f, 0, 0};
+	view2proj.row2 = float4{0, 0, (far + near) / (near - far), 2 * far * near / (near - far)};
+	view2proj.row3 = float4{0, 0, +1, 0};
+
+	return view2proj;
+}
+
+inline float4x4 float4x4::LookAt(float3 eye, float3 target, float3 up)
+{
+	float3 f = (target - eye).Normalized();
+	float3 u = up.Normalized();
+	float3 s = float3::Cross(f, u).Normalized();
+	u = float3::Cross(s, f);
+
+	float4x4 world2view;
+
+	// from https://stackoverflow.com/questions/19740463/lookat-function-im-going-crazy but transposed
+	world2view.row0 = float4{  s.x,  s.y,  s.z, -float3::Dot(s, eye)};
+	world2view.row1 = float4{  u.x,  u.y,  u.z, -float3::Dot(u, eye)};
+	world2view.row2 = float4{  f.x,  f.y,  f.z, -float3::Dot(f, eye)}; 
+	world2view.row3 = float4{0, 0, 0, 1};
+
+	return world2view;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <math.h>
+
+#include "simd.h"
+
+// Four independent floats processed together, one per SIMD lane. Used to work on structure-of-arrays data,
+// e.g. four lights at once, where float4 is a single vector with x, y, z and w.
+struct floatx4
+{
+#if RASTERIZER_MATH_SSE
+    __m128 v;
+#elif RASTERIZER_MATH_NEON
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+
+    static floatx4 Set1(float value);
+    // pointer has to be 16 byte aligned
+    static floatx4 Load(const float* pointer);
+    void Store(float* pointer) const;
+
+    floatx4 operator+(const floatx4& other) const;
+    floatx4 operator-(const floatx4& other) const;
+    floatx4 operator*(const floatx4& other) const;
+    floatx4 operator/(const floatx4& other) const;
+
+    static floatx4 Max(const floatx4& a, const floatx4& b);
+    static floatx4 Sqrt(const floatx4& a);
+    // Sum of the four lanes
+    static float Sum(const floatx4& a);
+    // True if any lane is greater than zero
+    static bool AnyPositive(const floatx4& a);
+};
+
+inline floatx4 floatx4::Set1(float value)
+{
+    floatx4 result;
+#if RASTERIZER_MATH_SSE
+    result.v = _mm_set1_ps(value);
+#elif RASTERIZER_MATH_NEON
+    result.v = vdupq_n_f32(value);
+#else
+    result.v[0] = result.v[1] = result.v[2] = result.v[3] = value;
+#endif
+    return result;
+}
+
+inline floatx4 floatx4::Load(const float* pointer)
+{
+    floatx4 result;
+#if RASTERIZER_MATH_SSE
+    result.v = _mm_load_ps(pointer);
+#elif RASTERIZER_MATH_NEON
+    result.v = vld1q_f32(pointer);
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        result.v[i] = pointer[i];
+    }
+#endif
+    return result;
+}
+
+inline void floatx4::Store(float* pointer) const
+{
+#if RASTERIZER_MATH_SSE
+    _mm_store_ps(pointer, v);
+#elif RASTERIZER_MATH_NEON
+    vst1q_f32(pointer, v);
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        pointer[i] = v[i];
+    }
+#endif
+}
+
+inline floatx4 floatx4::operator+(const floatx4& other) const
+{
+    floatx4 result;
+#if RASTERIZER_MATH_SSE
+    result.v = _mm_add_ps(v, other.v);
+#elif RASTERIZER_MATH_NEON
+    result.v = vaddq_f32(v, other.v);
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        result.v[i] = v[i] + other.v[i];
+    }
+#endif
+    return result;
+}
+
+inline floatx4 floatx4::operator-(const floatx4& other) const
+{
+    floatx4 result;
+#if RASTERIZER_MATH_SSE
+    result.v = _mm_sub_ps(v, other.v);
+#elif RASTERIZER_MATH_NEON
+    result.v = vsubq_f32(v, other.v);
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        result.v[i] = v[i] - other.v[i];
+    }
+#endif
+    return result;
+}
+
+inline floatx4 floatx4::operator*(const floatx4& other) const
+{
+    floatx4 result;
+#if RASTERIZER_MATH_SSE
+    result.v = _mm_mul_ps(v, other.v);
+#elif RASTERIZER_MATH_NEON
+    result.v = vmulq_f32(v, other.v);
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        result.v[i] = v[i] * other.v[i];
+    }
+#endif
+    return result;
+}
+
+inline floatx4 floatx4::operator/(const floatx4& other) const
+{
+    floatx4 result;
+#if RASTERIZER_MATH_SSE
+    result.v = _mm_div_ps(v, other.v);
+#elif RASTERIZER_MATH_NEON
+    result.v = vdivq_f32(v, other.v);
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        result.v[i] = v[i] / other.v[i];
+    }
+#endif
+    return result;
+}
+
+inline floatx4 floatx4::Max(const floatx4& a, const floatx4& b)
+{
+    floatx4 result;
+#if RASTERIZER_MATH_SSE
+    result.v = _mm_max_ps(a.v, b.v);
+#elif RASTERIZER_MATH_NEON
+    result.v = vmaxq_f32(a.v, b.v);
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        result.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+    }
+#endif
+    return result;
+}
+
+inline floatx4 floatx4::Sqrt(const floatx4& a)
+{
+    floatx4 result;
+#if RASTERIZER_MATH_SSE
+    result.v = _mm_sqrt_ps(a.v);
+#elif RASTERIZER_MATH_NEON
+    result.v = vsqrtq_f32(a.v);
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        result.v[i] = sqrtf(a.v[i]);
+    }
+#endif
+    return result;
+}
+
+inline float floatx4::Sum(const floatx4& a)
+{
+#if RASTERIZER_MATH_SSE
+    const __m128 pairs = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+#elif RASTERIZER_MATH_NEON
+    return vaddvq_f32(a.v);
+#else
+    return (a.v[0] + a.v[2]) + (a.v[1] + a.v[3]);
+#endif
+}
+
+inline bool floatx4::AnyPositive(const floatx4& a)
+{
+#if RASTERIZER_MATH_SSE
+    return _mm_movemask_ps(_mm_cmpgt_ps(a.v, _mm_setzero_ps())) != 0;
+#elif RASTERIZER_MATH_NEON
+    return vmaxvq_f32(a.v) > 0.0f;
+#else
+    return a.v[0] > 0.0f || a.v[1] > 0.0f || a.v[2] > 0.0f || a.v[3] > 0.0f;
+#endif
+}
@@ -1,12 +0,0 @@
-#include "int3.h"
-#pragma once
-
-int3::int3() 
-	: a(0), b(0), c(0)
-{
-}
-
-int3::int3(int a, int b, int c) 
-	: a(a), b(b), c(c)
-{
-}
\ No newline at end of file
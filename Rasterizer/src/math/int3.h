@@ -2,10 +2,10 @@
 
 struct int3
 {
-	int3();
-	int3(int a, int b, int c);
+	constexpr int3() : a(0), b(0), c(0) {}
+	constexpr int3(int a, int b, int c) : a(a), b(b), c(c) {}
 
 	int a;
 	int b;
 	int c;
-};
\ No newline at end of file
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+// Picks the instruction set for the vector paths of float4 and float4x4.
+// Define RASTERIZER_SCALAR_MATH to build the plain C++ reference versions instead, both give identical results.
+#if !defined(RASTERIZER_SCALAR_MATH) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define RASTERIZER_MATH_SSE 1
+#include <xmmintrin.h>
+#elif !defined(RASTERIZER_SCALAR_MATH) && (defined(__aarch64__) || defined(_M_ARM64))
+#define RASTERIZER_MATH_NEON 1
+#include <arm_neon.h>
+#endif
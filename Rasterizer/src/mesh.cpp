@@ -1,6 +1,7 @@
 #include "mesh.h"
 
 #include <cassert>
+#include <cmath>
 
 float4x4 Transform::GetModelMatrix() const
 {
@@ -22,13 +23,26 @@ float4x4 Transform::GetModelMatrix() const
 	return objectToWorld;
 }
 
+constexpr float Camera::NearPlane;
+constexpr float Camera::FarPlane;
+
+float4x4 Camera::GetViewMatrix() const
+{
+	return float4x4::LookAt(position, target, float3(0, 1, 0));
+}
+
+float4x4 Camera::GetProjectionMatrix(float aspectRatio) const
+{
+	return float4x4::Perspective(45.0, aspectRatio, NearPlane, FarPlane);
+}
+
 static void DoTransformation(Vertex& v, const Camera& camera, const Transform& transform, float aspectRatio)
 {
 	float3 normal = v.normal;
 
 	float4x4 objectToWorld = transform.GetModelMatrix();
-	float4x4 worldToView = float4x4::LookAt(camera.position, camera.target, float3(0, 1, 0));
-	float4x4 viewToProjection = float4x4::Perspective(45.0, aspectRatio, 0.1f, 100.0f);
+	float4x4 worldToView = camera.GetViewMatrix();
+	float4x4 viewToProjection = camera.GetProjectionMatrix(aspectRatio);
 
 	float4x4 objectToProjection = viewToProjection * worldToView * objectToWorld;
 	float4 transformedVertexPosition = objectToProjection * v.position;
@@ -45,6 +59,70 @@ void Mesh::SetColor(float3 color)
 	}
 }
 
+void Mesh::RebuildStreams()
+{
+	static_assert(sizeof(float3) == 3 * sizeof(float), "position stream has to be tightly packed");
+
+	const size_t count = vertices.size();
+	streams.positions.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		streams.positions[i] = vertices[i].position;
+	}
+
+	streams.indices16.clear();
+	streams.indices32.clear();
+	if (count <= 0x10000)
+	{
+		streams.indices16.reserve(indices.size() * 3);
+		for (const int3& triangle : indices)
+		{
+			streams.indices16.push_back((uint16_t)triangle.a);
+			streams.indices16.push_back((uint16_t)triangle.b);
+			streams.indices16.push_back((uint16_t)triangle.c);
+		}
+	}
+	else
+	{
+		streams.indices32.reserve(indices.size() * 3);
+		for (const int3& triangle : indices)
+		{
+			streams.indices32.push_back((uint32_t)triangle.a);
+			streams.indices32.push_back((uint32_t)triangle.b);
+			streams.indices32.push_back((uint32_t)triangle.c);
+		}
+	}
+
+	RecalculateBounds();
+}
+
+void Mesh::RecalculateBounds()
+{
+	boundingBox = BoundingBox{ float3(0, 0, 0), float3(0, 0, 0) };
+	boundingSphere = BoundingSphere{ float3(0, 0, 0), 0.0f };
+	if (vertices.empty())
+	{
+		return;
+	}
+
+	boundingBox.min = vertices[0].position;
+	boundingBox.max = vertices[0].position;
+	for (const Vertex& v : vertices)
+	{
+		boundingBox.min = float3(fmin(boundingBox.min.x, v.position.x), fmin(boundingBox.min.y, v.position.y), fmin(boundingBox.min.z, v.position.z));
+		boundingBox.max = float3(fmax(boundingBox.max.x, v.position.x), fmax(boundingBox.max.y, v.position.y), fmax(boundingBox.max.z, v.position.z));
+	}
+
+	// Centered on the box, not the tightest sphere but close enough for culling
+	boundingSphere.center = (boundingBox.min + boundingBox.max) * 0.5f;
+	for (const Vertex& v : vertices)
+	{
+		float3 offset = v.position - boundingSphere.center;
+		boundingSphere.radius = fmax(boundingSphere.radius, float3::Dot(offset, offset));
+	}
+	boundingSphere.radius = sqrt(boundingSphere.radius);
+}
+
 Mesh Mesh::Transformed(const Transform& transform, const Camera& camera, float aspectRatio) const
 {
 	Mesh m;
@@ -57,6 +135,7 @@ Mesh Mesh::Transformed(const Transform& transform, const Camera& camera, float a
 		DoTransformation(newVertex, camera, transform, aspectRatio);
 		m.vertices.push_back(newVertex);
 	}
+	m.RebuildStreams();
 
 	return m;
 }
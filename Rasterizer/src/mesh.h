@@ -1,15 +1,23 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
+#include "alignedAllocator.h"
 #include "math/float3.h"
 #include "math/int3.h"
 #include "math/float4x4.h"
 
 struct Camera
 {
+	static constexpr float NearPlane = 0.1f;
+	static constexpr float FarPlane = 100.0f;
+
 	float3 position;
 	float3 target;
+
+	float4x4 GetViewMatrix() const;
+	float4x4 GetProjectionMatrix(float aspectRatio) const;
 };
 
 struct Transform
@@ -34,13 +42,43 @@ struct Vertex
 	float v;
 };
 
+struct BoundingBox
+{
+	float3 min;
+	float3 max;
+};
+
+struct BoundingSphere
+{
+	float3 center;
+	float radius;
+};
+
+// Vertex attributes split out of the vertices for the stages that only need them, so the vertex stage loads
+// positions without the rest of each Vertex. Shading still reads the Vertex records.
+struct VertexStreams
+{
+	AlignedVector<float3> positions;
+
+	// Flat triangle list, 16-bit when every vertex can be indexed with it. Only one of them is filled.
+	std::vector<uint16_t> indices16;
+	std::vector<uint32_t> indices32;
+};
+
 class Mesh
 {
 public:
 	std::vector<Vertex> vertices;
 	std::vector<int3> indices; // int3 = triangle
+	// Derived from vertices and indices, call RebuildStreams after changing them
+	VertexStreams streams;
+	// Object space bounds of the vertices, updated by RebuildStreams
+	BoundingBox boundingBox;
+	BoundingSphere boundingSphere;
 	void SetColor(float3 color);
+	void RebuildStreams();
+	void RecalculateBounds();
 	Mesh Transformed(const Transform& transform, const Camera& camera, float aspectRatio) const;
 	static void TransformVertex(Vertex& v, const Transform& transform, const Camera& camera, float aspectRatio);
-	class Buffer* texture = nullptr;
+	const class Texture* texture = nullptr;
 };
\ No newline at end of file
@@ -40,6 +40,8 @@ Mesh MeshBuilder::BuildTriangle()
 
 	m.indices.push_back(int3(0, 1, 2));
 
+	m.RebuildStreams();
+
 	return m;
 }
 
@@ -69,6 +71,8 @@ Mesh MeshBuilder::BuildCone()
 		m.indices.push_back(int3(i, next, numBaseVertices)); // bottom tri
 	}
 
+	m.RebuildStreams();
+
 	return m;
 }
 
@@ -164,6 +168,8 @@ Mesh MeshBuilder::BuildUnitSphere(int subdivisions)
 		m.indices.push_back(int3(indices[i], indices[i + 1], indices[i + 2]));
 	}
 
+	m.RebuildStreams();
+
 	return m;
 }
 
@@ -204,6 +210,8 @@ Mesh MeshBuilder::BuildTorus()
 
 	RecalculateNormals(m);
 
+	m.RebuildStreams();
+
 	return m;
 }
 
@@ -312,5 +320,7 @@ Mesh MeshBuilder::BuildCube()
 		m.indices.push_back(int3(indices[i+0], indices[i+1], indices[i+2]));
 	}
 
+	m.RebuildStreams();
+
 	return m;
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+std::atomic<bool> Profiler::g_recording{ false };
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		int64_t start;
+		int64_t end;
+	};
+
+	// Events of one thread, only that thread appends to them. Kept after the thread exits, until they are written.
+	struct ThreadEvents
+	{
+		int id;
+		std::string name;
+		std::vector<Event> events;
+	};
+
+	std::mutex g_threadsMutex;
+
+	std::vector<std::unique_ptr<ThreadEvents>>& Threads()
+	{
+		static std::vector<std::unique_ptr<ThreadEvents>> threads;
+		return threads;
+	}
+
+	ThreadEvents& LocalThread()
+	{
+		thread_local ThreadEvents* local = nullptr;
+		if (local == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(g_threadsMutex);
+			std::vector<std::unique_ptr<ThreadEvents>>& threads = Threads();
+			threads.emplace_back(new ThreadEvents());
+			local = threads.back().get();
+			local->id = (int)threads.size();
+			local->name = "Thread " + std::to_string(local->id);
+		}
+		return *local;
+	}
+
+	void WriteEscaped(FILE* file, const char* text)
+	{
+		for (; *text != '\0'; text++)
+		{
+			if (*text == '"' || *text == '\\')
+			{
+				fputc('\\', file);
+			}
+			fputc(*text, file);
+		}
+	}
+}
+
+void Profiler::Start()
+{
+	// Fixes the time origin before the first event
+	Now();
+	LocalThread();
+	g_recording.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::Stop()
+{
+	g_recording.store(false, std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	LocalThread().name = name;
+}
+
+int64_t Profiler::Now()
+{
+	static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void Profiler::Record(const char* name, int64_t start, int64_t end)
+{
+	LocalThread().events.push_back(Event{ name, start, end });
+}
+
+bool Profiler::WriteTrace(const char* filename)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(g_threadsMutex);
+
+	// Complete events ("X") with times in microseconds, and metadata ("M") naming the timelines
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Rasterizer\"}}");
+	for (const std::unique_ptr<ThreadEvents>& thread : Threads())
+	{
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", thread->id);
+		WriteEscaped(file, thread->name.c_str());
+		fprintf(file, "\"}}");
+		fprintf(file, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}", thread->id, thread->id);
+
+		for (const Event& event : thread->events)
+		{
+			fprintf(file, ",\n{\"name\":\"");
+			WriteEscaped(file, event.name);
+			fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", thread->id, event.start / 1000.0, (event.end - event.start) / 1000.0);
+		}
+		thread->events.clear();
+	}
+	fprintf(file, "\n]}\n");
+
+	const bool written = ferror(file) == 0;
+	return fclose(file) == 0 && written;
+}
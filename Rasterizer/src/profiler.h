@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Records scoped timing events per thread and writes them as Chrome trace-event JSON, which opens in
+// https://ui.perfetto.dev or chrome://tracing with one timeline per thread:
+//
+//   Profiler::Start();
+//   { PROFILE_SCOPE("Frame"); ... }
+//   Profiler::Stop();
+//   Profiler::WriteTrace("trace.json");
+//
+// While stopped a scope costs one relaxed atomic load. Building with RASTERIZER_DISABLE_PROFILING removes the scopes completely.
+namespace Profiler
+{
+	extern std::atomic<bool> g_recording;
+
+	void Start();
+	void Stop();
+	inline bool IsRecording()
+	{
+#ifdef RASTERIZER_DISABLE_PROFILING
+		return false;
+#else
+		return g_recording.load(std::memory_order_relaxed);
+#endif
+	}
+
+	// Shown as the name of the calling thread's timeline, can be called whether recording or not
+	void SetThreadName(const char* name);
+
+	// Writes every event recorded so far and forgets them. Recording has to be stopped and the threads that
+	// recorded have to be idle. False if the file can't be written.
+	bool WriteTrace(const char* filename);
+
+	// Nanoseconds since the profiler was first used
+	int64_t Now();
+	// name has to outlive the recording, a string literal
+	void Record(const char* name, int64_t start, int64_t end);
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name)
+			: m_name(IsRecording() ? name : nullptr), m_start(m_name != nullptr ? Now() : 0)
+		{
+		}
+
+		~Scope()
+		{
+			if (m_name != nullptr)
+			{
+				Record(m_name, m_start, Now());
+			}
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* m_name;
+		int64_t m_start;
+	};
+}
+
+#define PROFILE_CONCATENATE_INNER(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_INNER(a, b)
+
+#ifdef RASTERIZER_DISABLE_PROFILING
+#define PROFILE_SCOPE(name)
+#else
+// Times the rest of the enclosing block
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCATENATE(profileScope, __LINE__)(name)
+#endif
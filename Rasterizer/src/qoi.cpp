@@ -0,0 +1,316 @@
+#include "qoi.h"
+
+#include "threadPool.h"
+
+#include <algorithm>
+#include <cassert>
+
+static constexpr size_t HeaderSize = 14;
+static constexpr uint8_t EndMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+static constexpr uint8_t OpIndex = 0x00;
+static constexpr uint8_t OpDiff = 0x40;
+static constexpr uint8_t OpLuma = 0x80;
+static constexpr uint8_t OpRun = 0xc0;
+static constexpr uint8_t OpRGB = 0xfe;
+static constexpr uint8_t OpRGBA = 0xff;
+static constexpr uint8_t OpMask = 0xc0;
+
+static constexpr int MaxRun = 62;
+// Worst case per pixel is OpRGBA with 4 channels
+static constexpr size_t MaxPixelBytes = 5;
+
+// The format starts with opaque black as the previous pixel and an index of zeroes
+static constexpr uint32_t StartPixel = 0xff000000;
+
+static inline int Hash(uint32_t argb)
+{
+	const uint32_t a = argb >> 24;
+	const uint32_t r = (argb >> 16) & 0xff;
+	const uint32_t g = (argb >> 8) & 0xff;
+	const uint32_t b = argb & 0xff;
+
+	return (int)((r * 3 + g * 5 + b * 7 + a * 11) % 64);
+}
+
+static void WriteUint32(uint8_t* output, uint32_t value)
+{
+	output[0] = (uint8_t)(value >> 24);
+	output[1] = (uint8_t)(value >> 16);
+	output[2] = (uint8_t)(value >> 8);
+	output[3] = (uint8_t)(value >> 0);
+}
+
+static uint32_t ReadUint32(const uint8_t* data)
+{
+	return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+// State of the encoder (and of any decoder) in front of a pixel
+struct EncoderState
+{
+	uint32_t index[64];
+	uint32_t previous;
+};
+
+// Encodes rows [rowBegin, rowEnd) starting from the given state, ending with any open run written out. Returns the end of the output.
+static uint8_t* EncodeRows(const uint32_t* topRow, ptrdiff_t rowStride, int width, int rowBegin, int rowEnd, EncoderState state, uint8_t* output)
+{
+	uint32_t* index = state.index;
+	uint32_t previous = state.previous;
+	int run = 0;
+
+	for (int y = rowBegin; y < rowEnd; y++)
+	{
+		const uint32_t* row = topRow + y * rowStride;
+		for (int x = 0; x < width; x++)
+		{
+			const uint32_t pixel = row[x];
+			if (pixel == previous)
+			{
+				run++;
+				if (run == MaxRun)
+				{
+					*output++ = (uint8_t)(OpRun | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run > 0)
+			{
+				*output++ = (uint8_t)(OpRun | (run - 1));
+				run = 0;
+			}
+
+			const int slot = Hash(pixel);
+			if (index[slot] == pixel)
+			{
+				*output++ = (uint8_t)(OpIndex | slot);
+				previous = pixel;
+				continue;
+			}
+			index[slot] = pixel;
+
+			if ((pixel >> 24) != (previous >> 24))
+			{
+				*output++ = OpRGBA;
+				*output++ = (uint8_t)(pixel >> 16);
+				*output++ = (uint8_t)(pixel >> 8);
+				*output++ = (uint8_t)(pixel >> 0);
+				*output++ = (uint8_t)(pixel >> 24);
+				previous = pixel;
+				continue;
+			}
+
+			// Channel differences wrap around like 8-bit values
+			const int dr = (int8_t)(uint8_t)((pixel >> 16) - (previous >> 16));
+			const int dg = (int8_t)(uint8_t)((pixel >> 8) - (previous >> 8));
+			const int db = (int8_t)(uint8_t)(pixel - previous);
+			const int drg = dr - dg;
+			const int dbg = db - dg;
+
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+			{
+				*output++ = (uint8_t)(OpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+			}
+			else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7)
+			{
+				*output++ = (uint8_t)(OpLuma | (dg + 32));
+				*output++ = (uint8_t)(((drg + 8) << 4) | (dbg + 8));
+			}
+			else
+			{
+				*output++ = OpRGB;
+				*output++ = (uint8_t)(pixel >> 16);
+				*output++ = (uint8_t)(pixel >> 8);
+				*output++ = (uint8_t)(pixel >> 0);
+			}
+			previous = pixel;
+		}
+	}
+
+	if (run > 0)
+	{
+		*output++ = (uint8_t)(OpRun | (run - 1));
+	}
+
+	return output;
+}
+
+void Qoi::Encode(const uint32_t* topRow, ptrdiff_t rowStride, int width, int height, std::vector<uint8_t>& output, int stripCount)
+{
+	assert(width > 0 && height > 0);
+	stripCount = std::max(1, std::min(stripCount, height));
+
+	uint8_t header[HeaderSize] = { 'q', 'o', 'i', 'f' };
+	WriteUint32(header + 4, (uint32_t)width);
+	WriteUint32(header + 8, (uint32_t)height);
+	header[12] = 4; // RGBA
+	header[13] = 0; // sRGB with linear alpha
+	output.insert(output.end(), header, header + HeaderSize);
+
+	auto stripRowBegin = [&](int strip) { return (int)((int64_t)height * strip / stripCount); };
+
+	// A strip can start encoding once it knows the state the serial encoder would have in front of it:
+	// the previous pixel is the last pixel of the strip above, and every index slot holds the last pixel
+	// above that hashed to it (a decoder puts every pixel it outputs into the index).
+	// Each strip finds its own last pixel per slot in parallel, then the states are accumulated from the top.
+	struct StripSummary
+	{
+		uint32_t lastInSlot[64];
+		uint64_t usedSlots;
+	};
+	std::vector<StripSummary> summaries(stripCount);
+	std::vector<EncoderState> states(stripCount);
+
+	ThreadPool& pool = ThreadPool::Get();
+	if (stripCount > 1)
+	{
+		pool.ParallelFor(stripCount - 1, [&](int strip)
+		{
+			StripSummary& summary = summaries[strip];
+			summary.usedSlots = 0;
+			for (int y = stripRowBegin(strip); y < stripRowBegin(strip + 1); y++)
+			{
+				const uint32_t* row = topRow + y * rowStride;
+				for (int x = 0; x < width; x++)
+				{
+					const int slot = Hash(row[x]);
+					summary.lastInSlot[slot] = row[x];
+					summary.usedSlots |= 1ull << slot;
+				}
+			}
+		});
+	}
+
+	std::fill(states[0].index, states[0].index + 64, 0u);
+	states[0].previous = StartPixel;
+	for (int strip = 1; strip < stripCount; strip++)
+	{
+		states[strip] = states[strip - 1];
+		const StripSummary& above = summaries[strip - 1];
+		for (int slot = 0; slot < 64; slot++)
+		{
+			if (above.usedSlots & (1ull << slot))
+			{
+				states[strip].index[slot] = above.lastInSlot[slot];
+			}
+		}
+		states[strip].previous = topRow[(stripRowBegin(strip) - 1) * rowStride + width - 1];
+	}
+
+	std::vector<std::vector<uint8_t>> strips(stripCount);
+	pool.ParallelFor(stripCount, [&](int strip)
+	{
+		const int rowBegin = stripRowBegin(strip);
+		const int rowEnd = stripRowBegin(strip + 1);
+		std::vector<uint8_t>& bytes = strips[strip];
+		bytes.resize((size_t)(rowEnd - rowBegin) * width * MaxPixelBytes);
+		const uint8_t* end = EncodeRows(topRow, rowStride, width, rowBegin, rowEnd, states[strip], bytes.data());
+		bytes.resize(end - bytes.data());
+	});
+
+	for (const std::vector<uint8_t>& bytes : strips)
+	{
+		output.insert(output.end(), bytes.begin(), bytes.end());
+	}
+	output.insert(output.end(), EndMarker, EndMarker + sizeof(EndMarker));
+}
+
+bool Qoi::ReadSize(const uint8_t* data, size_t size, int& width, int& height)
+{
+	if (size < HeaderSize + sizeof(EndMarker) || data[0] != 'q' || data[1] != 'o' || data[2] != 'i' || data[3] != 'f')
+	{
+		return false;
+	}
+
+	const uint32_t fileWidth = ReadUint32(data + 4);
+	const uint32_t fileHeight = ReadUint32(data + 8);
+	if (fileWidth == 0 || fileHeight == 0 || fileWidth > 0xffff || fileHeight > 0xffff)
+	{
+		return false;
+	}
+
+	width = (int)fileWidth;
+	height = (int)fileHeight;
+	return true;
+}
+
+bool Qoi::Decode(const uint8_t* data, size_t size, uint32_t* topRow, ptrdiff_t rowStride)
+{
+	int width = 0;
+	int height = 0;
+	if (ReadSize(data, size, width, height) == false)
+	{
+		return false;
+	}
+
+	uint32_t index[64] = { 0 };
+	uint32_t pixel = StartPixel;
+	int run = 0;
+
+	const uint8_t* input = data + HeaderSize;
+	// Ops never reach into the end marker, so a chunk can be read without checking the size byte by byte
+	const uint8_t* end = data + size - sizeof(EndMarker);
+
+	for (int y = 0; y < height; y++)
+	{
+		uint32_t* row = topRow + y * rowStride;
+		for (int x = 0; x < width; x++)
+		{
+			if (run > 0)
+			{
+				run--;
+				row[x] = pixel;
+				continue;
+			}
+
+			if (input >= end)
+			{
+				return false;
+			}
+
+			const uint8_t op = *input++;
+			if (op == OpRGB)
+			{
+				pixel = (pixel & 0xff000000) | ((uint32_t)input[0] << 16) | ((uint32_t)input[1] << 8) | input[2];
+				input += 3;
+			}
+			else if (op == OpRGBA)
+			{
+				pixel = ((uint32_t)input[3] << 24) | ((uint32_t)input[0] << 16) | ((uint32_t)input[1] << 8) | input[2];
+				input += 4;
+			}
+			else if ((op & OpMask) == OpIndex)
+			{
+				pixel = index[op];
+			}
+			else if ((op & OpMask) == OpDiff)
+			{
+				const uint32_t r = ((pixel >> 16) + ((op >> 4) & 0x03) - 2) & 0xff;
+				const uint32_t g = ((pixel >> 8) + ((op >> 2) & 0x03) - 2) & 0xff;
+				const uint32_t b = (pixel + (op & 0x03) - 2) & 0xff;
+				pixel = (pixel & 0xff000000) | (r << 16) | (g << 8) | b;
+			}
+			else if ((op & OpMask) == OpLuma)
+			{
+				const uint8_t second = *input++;
+				const int dg = (op & 0x3f) - 32;
+				const uint32_t r = ((pixel >> 16) + dg - 8 + ((second >> 4) & 0x0f)) & 0xff;
+				const uint32_t g = ((pixel >> 8) + dg) & 0xff;
+				const uint32_t b = (pixel + dg - 8 + (second & 0x0f)) & 0xff;
+				pixel = (pixel & 0xff000000) | (r << 16) | (g << 8) | b;
+			}
+			else
+			{
+				run = op & 0x3f;
+			}
+
+			index[Hash(pixel)] = pixel;
+			row[x] = pixel;
+		}
+	}
+
+	return true;
+}
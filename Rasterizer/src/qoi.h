@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Encoder and decoder for the QOI image format (https://qoiformat.org), lossless and fast in both directions.
+// Pixels are 0xAARRGGBB like in Buffer. Rows are passed as a pointer to the top row and the distance between rows
+// in pixels, which is negative for images stored bottom up.
+namespace Qoi
+{
+	// Appends the whole file to output. With more than one strip, horizontal strips of rows are encoded in parallel.
+	// The strips are joined into one standard stream, which can differ from the serial one only in how runs are split.
+	void Encode(const uint32_t* topRow, ptrdiff_t rowStride, int width, int height, std::vector<uint8_t>& output, int stripCount = 1);
+
+	// Reads the size from the header, false if the data is not a QOI image
+	bool ReadSize(const uint8_t* data, size_t size, int& width, int& height);
+	// Decodes into width * height pixels laid out as described by topRow and rowStride, false if the data is broken
+	bool Decode(const uint8_t* data, size_t size, uint32_t* topRow, ptrdiff_t rowStride);
+}
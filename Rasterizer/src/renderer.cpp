@@ -1,94 +1,466 @@
 #include "renderer.h"
 
 #include "math/float3.h"
+#include "math/float4.h"
+#include "math/float4x4.h"
+#include "math/floatx4.h"
 #include "light.h"
 #include "buffer.h"
 #include "mesh.h"
+#include "threadPool.h"
+#include "coverage.h"
+#include "texture.h"
+#include "profiler.h"
+#include "lightClusters.h"
 
+#include <algorithm>
+#include <functional>
 #include <cmath>
 #include <cassert>
 #include <cstdint>
+#include <deque>
 #include <ios>
 #include <iostream>
+#include <limits>
+#include <utility>
 
-static float3 GetVertexColor(const Vertex& v, const Transform& transform, const float3& cameraPosition, const DirectionalLight& directionalLight, const std::vector<PointLight>& pointLights, const SpotLight& spotLight)
+// Everything shading needs that is the same for the whole draw. The frame part is built once per frame,
+// the draw part once per draw.
+struct DrawConstants
 {
-    float4x4 objectToWorld = transform.GetModelMatrix();
+    // Per frame
+    float4x4 worldToProjection;
+    float3 cameraPosition;
 
+    float3 directionalLightDirection; // normalized
+    float3 directionalLightColor;
+
+    const LightClusters* lightClusters; // which point lights reach which part of the screen
+
+    float3 spotLightPosition;
+    float3 spotLightDirection; // normalized, points from the light
+    float3 spotLightColor;
+    float spotLightCosAngle;
+
+    // Per draw
+    float4x4 objectToWorld;
+    float4x4 normalToWorld; // inverse-transpose of objectToWorld, keeps normals perpendicular under non-uniform scale
+    Material material;
+    int specularPower; // material.specularExponent if it is a whole number up to MaxSpecularPower, otherwise -1
+};
+
+// Whole specular exponents are raised by repeated squaring, which is much cheaper than pow
+static constexpr int MaxSpecularPower = 1024;
+
+static DrawConstants BuildFrameConstants(const Camera& camera, float aspectRatio, const DirectionalLight& directionalLight, 
+    const LightClusters& lightClusters, const SpotLight& spotLight)
+{
+    DrawConstants constants;
+
+    constants.worldToProjection = camera.GetProjectionMatrix(aspectRatio) * camera.GetViewMatrix();
+    constants.cameraPosition = camera.position;
+
+    constants.directionalLightDirection = directionalLight.direction.Normalized();
+    constants.directionalLightColor = directionalLight.color;
+
+    constants.lightClusters = &lightClusters;
+
+    constants.spotLightPosition = spotLight.position;
+    constants.spotLightDirection = spotLight.direction.Normalized();
+    constants.spotLightColor = spotLight.color;
+    constants.spotLightCosAngle = spotLight.angle; // SpotLight::angle already holds the cosine of the cone angle
+
+    return constants;
+}
+
+static void SetDrawConstants(DrawConstants& constants, const float4x4& objectToWorld, const float4x4& normalToWorld, const Material& material)
+{
+    constants.objectToWorld = objectToWorld;
+    constants.normalToWorld = normalToWorld;
+    constants.material = material;
+
+    const float exponent = material.specularExponent;
+    const bool whole = exponent >= 0.0f && exponent <= (float)MaxSpecularPower && floorf(exponent) == exponent;
+    constants.specularPower = whole ? (int)exponent : -1;
+}
+
+static float SpecularPower(float base, const DrawConstants& constants)
+{
+    if (constants.specularPower < 0)
+    {
+        return (float)pow((double)base, (double)constants.material.specularExponent);
+    }
+
+    float result = 1.0f;
+    for (int power = constants.specularPower; power != 0; power >>= 1)
+    {
+        if (power & 1)
+        {
+            result *= base;
+        }
+        base *= base;
+    }
+    return result;
+}
+
+static floatx4 SpecularPower(floatx4 base, const DrawConstants& constants)
+{
+    if (constants.specularPower < 0)
+    {
+        alignas(16) float lanes[4];
+        base.Store(lanes);
+        for (float& lane : lanes)
+        {
+            lane = SpecularPower(lane, constants);
+        }
+        return floatx4::Load(lanes);
+    }
+
+    floatx4 result = floatx4::Set1(1.0f);
+    for (int power = constants.specularPower; power != 0; power >>= 1)
+    {
+        if (power & 1)
+        {
+            result = result * base;
+        }
+        base = base * base;
+    }
+    return result;
+}
+
+// Shading work that is the same for a whole draw. Every combination compiles its own copy of the raster loop with
+// the parts it doesn't use left out, and each draw picks its copy once.
+enum ShadingFeatures : unsigned
+{
+    ShadeTexture = 1 << 0,      // texture instead of vertex colors
+    ShadeSpecular = 1 << 1,     // the material has a specular intensity
+    ShadeSpotLight = 1 << 2,    // the spot light isn't black
+    ShadePointLights = 1 << 3,  // some point light reaches the screen
+    ShadingPermutations = 1 << 4,
+};
+
+// pointLights are the point lights that can reach the vertex, unused without ShadePointLights
+template <unsigned Features>
+static float3 GetVertexColor(const Vertex& v, const DrawConstants& constants, const LightClusters::Lights& pointLights)
+{
     float3 diffuse(0,0,0);
     float3 specular(0,0,0);
 
     float3 vn = v.normal.Normalized();
-    float3 N = objectToWorld * float4{vn.x, vn.y, vn.z, 0.0f}; // 0 ignores translation for normals, scale might be bad. see: https://learnopengl.com/Lighting/Basic-Lighting -> "One Last Thing" section
+    float3 N = constants.normalToWorld * float4{vn.x, vn.y, vn.z, 0.0f}; // 0 ignores translation for normals
     N.Normalize();
 
     // Directional light
-    float3 lightDirection = directionalLight.direction.Normalized();
-    float intensity = fmax(0.0f, float3::Dot(N, lightDirection));
-    diffuse += directionalLight.color * intensity;
-
-    // Point lights
-    float3 worldSpaceVertexPosition = objectToWorld * v.position;
-    for (const PointLight& pointLight : pointLights)
-    {
-        // Diffuse
-        float3 toLight = (pointLight.position - worldSpaceVertexPosition).Normalized();
-		float intensity = fmax(0.0f, float3::Dot(N, toLight));
-		diffuse += pointLight.color * intensity;
-
-        // Specular
-        float3 reflection = float3::Reflect(-toLight, N);
-        float3 toCamera = (cameraPosition - worldSpaceVertexPosition).Normalized();
-        float specularIntensity = fmax(0.0f, float3::Dot(reflection, toCamera));
-        float value = (float)pow(specularIntensity, 32);
-        specular += pointLight.color * value;
-	}
+    float intensity = fmax(0.0f, float3::Dot(N, constants.directionalLightDirection));
+    diffuse += constants.directionalLightColor * intensity;
+
+    // Point lights, LaneCount at a time. The reflection of the light direction L around N is 2 (N.L) N - L,
+    // so its dot product with the direction to the camera V is 2 (N.L) (N.V) - L.V.
+    float3 worldSpaceVertexPosition = constants.objectToWorld * v.position;
+    float3 toCamera = (Features & ShadeSpecular) ? (constants.cameraPosition - worldSpaceVertexPosition).Normalized() : float3();
+    if (Features & ShadePointLights)
+    {
+        const floatx4 zero = floatx4::Set1(0.0f);
+        const floatx4 one = floatx4::Set1(1.0f);
+        const floatx4 two = floatx4::Set1(2.0f);
+        const floatx4 positionX = floatx4::Set1(worldSpaceVertexPosition.x);
+        const floatx4 positionY = floatx4::Set1(worldSpaceVertexPosition.y);
+        const floatx4 positionZ = floatx4::Set1(worldSpaceVertexPosition.z);
+        const floatx4 normalX = floatx4::Set1(N.x);
+        const floatx4 normalY = floatx4::Set1(N.y);
+        const floatx4 normalZ = floatx4::Set1(N.z);
+        const floatx4 toCameraX = floatx4::Set1(toCamera.x);
+        const floatx4 toCameraY = floatx4::Set1(toCamera.y);
+        const floatx4 toCameraZ = floatx4::Set1(toCamera.z);
+        const floatx4 normalDotCamera = floatx4::Set1(float3::Dot(N, toCamera));
+        // Keeps a light exactly at the vertex (or a padding light) from dividing by zero
+        const floatx4 minDistanceSquared = floatx4::Set1(1e-12f);
+
+        floatx4 diffuseR = zero, diffuseG = zero, diffuseB = zero;
+        floatx4 specularR = zero, specularG = zero, specularB = zero;
+        for (int i = 0; i < pointLights.count; i += LightClusters::LaneCount)
+        {
+            const floatx4 toLightX = floatx4::Load(pointLights.positionX + i) - positionX;
+            const floatx4 toLightY = floatx4::Load(pointLights.positionY + i) - positionY;
+            const floatx4 toLightZ = floatx4::Load(pointLights.positionZ + i) - positionZ;
+            const floatx4 distanceSquared = floatx4::Max(toLightX * toLightX + toLightY * toLightY + toLightZ * toLightZ, minDistanceSquared);
+
+            // PointLight::Attenuation, (1 - (d / range)^4)^2 written with squared distances
+            const floatx4 ratioSquared = distanceSquared * floatx4::Load(pointLights.inverseRangeSquared + i);
+            const floatx4 window = floatx4::Max(one - ratioSquared * ratioSquared, zero);
+            const floatx4 attenuation = window * window;
+            if (floatx4::AnyPositive(attenuation) == false)
+            {
+                continue;
+            }
+
+            // Diffuse
+            const floatx4 inverseDistance = one / floatx4::Sqrt(distanceSquared);
+            const floatx4 normalDotLight = (normalX * toLightX + normalY * toLightY + normalZ * toLightZ) * inverseDistance;
+            const floatx4 diffuseIntensity = floatx4::Max(normalDotLight, zero) * attenuation;
+
+            const floatx4 colorR = floatx4::Load(pointLights.colorR + i);
+            const floatx4 colorG = floatx4::Load(pointLights.colorG + i);
+            const floatx4 colorB = floatx4::Load(pointLights.colorB + i);
+            diffuseR = diffuseR + colorR * diffuseIntensity;
+            diffuseG = diffuseG + colorG * diffuseIntensity;
+            diffuseB = diffuseB + colorB * diffuseIntensity;
+
+            // Specular
+            if (Features & ShadeSpecular)
+            {
+                const floatx4 lightDotCamera = (toLightX * toCameraX + toLightY * toCameraY + toLightZ * toCameraZ) * inverseDistance;
+                const floatx4 specularIntensity = floatx4::Max(two * normalDotLight * normalDotCamera - lightDotCamera, zero);
+                const floatx4 specularValue = SpecularPower(specularIntensity, constants) * attenuation;
+                specularR = specularR + colorR * specularValue;
+                specularG = specularG + colorG * specularValue;
+                specularB = specularB + colorB * specularValue;
+            }
+        }
+
+        diffuse += float3(floatx4::Sum(diffuseR), floatx4::Sum(diffuseG), floatx4::Sum(diffuseB));
+        specular += float3(floatx4::Sum(specularR), floatx4::Sum(specularG), floatx4::Sum(specularB));
+    }
 
     // Spot light
-    float3 toSpotlight = (spotLight.position - worldSpaceVertexPosition).Normalized();
-    float theta = float3::Dot(toSpotlight, -spotLight.direction.Normalized());
-    if (theta > spotLight.angle)
+    if (Features & ShadeSpotLight)
+    {
+        float3 toSpotlight = (constants.spotLightPosition - worldSpaceVertexPosition).Normalized();
+        float theta = float3::Dot(toSpotlight, -constants.spotLightDirection);
+        if (theta > constants.spotLightCosAngle)
+        {
+            // Same calc as point light, but limited by the angle
+
+            // Diffuse
+            float intensity = fmax(0.0f, float3::Dot(N, toSpotlight));
+            diffuse += constants.spotLightColor * intensity;
+
+            // Specular
+            if (Features & ShadeSpecular)
+            {
+                float3 reflection = float3::Reflect(-toSpotlight, N);
+                float specularIntensity = fmax(0.0f, float3::Dot(reflection, toCamera));
+                float value = SpecularPower(specularIntensity, constants);
+                specular += constants.spotLightColor * value;
+            }
+        }
+    }
+
+    if (Features & ShadeSpecular)
+    {
+        specular = specular * constants.material.specularIntensity;
+    }
+
+    return v.color * (constants.material.ambient + diffuse + specular).Clamped();
+}
+
+// Screen is split into square tiles, each rasterized by a single thread, so no two threads ever touch the same pixel.
+// Same tiles as the tiled buffer layout, so a tile is prepared by the thread that draws into it.
+static constexpr int TileSize = Buffer::TileSize;
+
+// Triangles are traversed in square blocks, one coverage span per block row
+static constexpr int BlockSize = Coverage::SpanWidth;
+static_assert(TileSize % BlockSize == 0, "Blocks must not straddle tiles");
+static_assert(BlockSize == Buffer::HiZBlockSize, "Raster blocks are used to update the Hi-Z buffer");
+
+// Planes in homogeneous clip space. Triangles are only ever clipped against the near plane and the guard band,
+// the viewport planes are only used to throw away triangles that are completely outside of them.
+enum ClipPlane
+{
+    ClipNear,
+    ClipGuardLeft,
+    ClipGuardRight,
+    ClipGuardBottom,
+    ClipGuardTop,
+    ClipLeft,
+    ClipRight,
+    ClipBottom,
+    ClipTop,
+    ClipPlaneCount,
+};
+
+static constexpr uint32_t ClippingPlanes = (1 << ClipNear) | (1 << ClipGuardLeft) | (1 << ClipGuardRight) | (1 << ClipGuardBottom) | (1 << ClipGuardTop);
+
+// Vertices are kept within this many pixels of the screen, so the integer edge functions in DrawTriangle can't overflow
+static constexpr float GuardBandPixels = 8192.0f;
+
+// Guard band size relative to the viewport, -guardBand * w <= x <= guardBand * w
+struct GuardBand
+{
+    float x;
+    float y;
+};
+
+static float ClipDistance(const float4& p, int plane, const GuardBand& guardBand)
+{
+    switch (plane)
     {
-        // Same calc as point light, but limited by the angle
-        
-        // Diffuse
-        float3 toLight = (spotLight.position - worldSpaceVertexPosition).Normalized();
-        float intensity = fmax(0.0f, float3::Dot(N, toLight));
-        diffuse += spotLight.color * intensity;
+    case ClipNear:          return p.w - Camera::NearPlane;
+    case ClipGuardLeft:     return guardBand.x * p.w + p.x;
+    case ClipGuardRight:    return guardBand.x * p.w - p.x;
+    case ClipGuardBottom:   return guardBand.y * p.w + p.y;
+    case ClipGuardTop:      return guardBand.y * p.w - p.y;
+    case ClipLeft:          return p.w + p.x;
+    case ClipRight:         return p.w - p.x;
+    case ClipBottom:        return p.w + p.y;
+    case ClipTop:           return p.w - p.y;
+    default:                return 0.0f;
+    }
+}
 
-        // Specular
-        float3 reflection = float3::Reflect(-toLight, N);
-        float3 toCamera = (cameraPosition - worldSpaceVertexPosition).Normalized();
-        float specularIntensity = fmax(0.0f, float3::Dot(reflection, toCamera));
-        float value = (float)pow(specularIntensity, 32);
-        specular += spotLight.color * value;
+// Bit for every plane the point is outside of
+static uint32_t ComputeOutcode(const float4& p, const GuardBand& guardBand)
+{
+    uint32_t outcode = 0;
+    for (int plane = 0; plane < ClipPlaneCount; plane++)
+    {
+        if (ClipDistance(p, plane, guardBand) < 0)
+        {
+            outcode |= 1 << plane;
+        }
     }
 
-    float3 ambient = float3(0.1f, 0.1f, 0.1f);
+    return outcode;
+}
+
+// Output of the vertex stage, one per mesh vertex
+struct ProcessedVertex
+{
+    float4 clipPosition;
+    float3 position; // after perspective division, only valid when the vertex is inside the near plane
+    uint32_t outcode;
+};
+
+struct ClipVertex
+{
+    float4 clipPosition;
+    const Vertex* vertex;
+};
+
+// Every clipping plane can add at most one vertex to the polygon
+static constexpr int MaxClipVertices = 3 + 5;
+
+static ClipVertex IntersectEdge(const ClipVertex& inside, const ClipVertex& outside, float insideDistance, float outsideDistance, std::deque<Vertex>& generatedVertices)
+{
+    // Always interpolated from the inside vertex, so an edge shared by two triangles is split at exactly the same point
+    const float t = insideDistance / (insideDistance - outsideDistance);
+    const Vertex& a = *inside.vertex;
+    const Vertex& b = *outside.vertex;
+
+    Vertex v(a.position + (b.position - a.position) * t, a.normal + (b.normal - a.normal) * t, a.color + (b.color - a.color) * t);
+    v.u = a.u + (b.u - a.u) * t;
+    v.v = a.v + (b.v - a.v) * t;
+    generatedVertices.push_back(v);
+
+    return ClipVertex{ inside.clipPosition + (outside.clipPosition - inside.clipPosition) * t, &generatedVertices.back() };
+}
+
+// Sutherland-Hodgman clipping of a convex polygon against the given planes, returns the new vertex count
+static int ClipPolygon(ClipVertex (&polygon)[MaxClipVertices], int count, uint32_t planes, const GuardBand& guardBand, std::deque<Vertex>& generatedVertices)
+{
+    for (int plane = 0; plane < ClipPlaneCount && count >= 3; plane++)
+    {
+        if ((planes & (1 << plane)) == 0)
+        {
+            continue;
+        }
+
+        ClipVertex clipped[MaxClipVertices];
+        int clippedCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const ClipVertex& current = polygon[i];
+            const ClipVertex& next = polygon[(i + 1) % count];
+            const float currentDistance = ClipDistance(current.clipPosition, plane, guardBand);
+            const float nextDistance = ClipDistance(next.clipPosition, plane, guardBand);
+
+            if (currentDistance >= 0)
+            {
+                clipped[clippedCount++] = current;
+            }
+
+            if ((currentDistance >= 0) != (nextDistance >= 0))
+            {
+                clipped[clippedCount++] = currentDistance >= 0
+                    ? IntersectEdge(current, next, currentDistance, nextDistance, generatedVertices)
+                    : IntersectEdge(next, current, nextDistance, currentDistance, generatedVertices);
+            }
+        }
+
+        count = clippedCount;
+        for (int i = 0; i < count; i++)
+        {
+            polygon[i] = clipped[i];
+        }
+    }
 
-    return v.color * (ambient + diffuse + specular).Clamped();
+    return count >= 3 ? count : 0;
 }
 
-static uint32_t SampleTexture(const Buffer* texture, float u, float v)
+struct Triangle
 {
-    assert(u > -0.0001f && u < 1.0001f);
-    assert(v > -0.0001f && v < 1.0001f);
+    // Positions after perspective division
+    float3 p1;
+    float3 p2;
+    float3 p3;
 
-    const int pixelX = (int)(u * texture->GetWidth());
-    const int pixelY = (int)(v * texture->GetHeight());
+    // Nearest depth the triangle can produce
+    float minDepth;
 
-    return texture->ColorAt(pixelX, pixelY);
+    // Untransformed mesh vertices, used for shading
+    const Vertex* v1;
+    const Vertex* v2;
+    const Vertex* v3;
+
+    // Bounding box in pixel space, max exclusive
+    int xMin;
+    int xMax;
+    int yMin;
+    int yMax;
+};
+
+// Interpolated depth can end up a little below the smallest vertex depth, keep a margin so occlusion tests stay conservative
+static float NearestDepth(float minVertexDepth)
+{
+    return minVertexDepth - 1e-4f * fmax(fabs(minVertexDepth), 1.0f);
 }
 
-static void DrawTriangle(Buffer& buffer, Vertex v1, Vertex v2, Vertex v3, Vertex untransformedV1, Vertex untransformedV2, Vertex untransformedV3, 
-    const Transform &transform, const float3 &cameraPosition, const DirectionalLight &directionalLight, const std::vector<PointLight> &pointLights,
-    const SpotLight &spotLight, const Buffer* texture)
+static bool SetupTriangle(Triangle& triangle, const Buffer& buffer, Renderer::CullMode cullMode)
 {
+    // Winding in the same pixel space DrawTriangle uses. Its edge functions only cover pixels of triangles with positive area,
+    // which are the front faces. Zero area triangles never cover anything.
+    const int64_t x1 = Renderer::ToPixelSpace(triangle.p1.x, buffer.GetWidth());
+    const int64_t y1 = Renderer::ToPixelSpace(triangle.p1.y, buffer.GetHeight());
+    const int64_t x2 = Renderer::ToPixelSpace(triangle.p2.x, buffer.GetWidth());
+    const int64_t y2 = Renderer::ToPixelSpace(triangle.p2.y, buffer.GetHeight());
+    const int64_t x3 = Renderer::ToPixelSpace(triangle.p3.x, buffer.GetWidth());
+    const int64_t y3 = Renderer::ToPixelSpace(triangle.p3.y, buffer.GetHeight());
+    const int64_t area = (x1 - x2) * (y3 - y1) - (y1 - y2) * (x3 - x1);
+
+    const bool frontFacing = area > 0;
+    if (area == 0 || 
+        (cullMode == Renderer::CullMode::Back && frontFacing == false) ||
+        (cullMode == Renderer::CullMode::Front && frontFacing))
+    {
+        return false;
+    }
+
+    // Back faces that are kept get flipped so the rasterizer can fill them
+    if (frontFacing == false)
+    {
+        std::swap(triangle.p2, triangle.p3);
+        std::swap(triangle.v2, triangle.v3);
+    }
+
+    const float3& p1 = triangle.p1;
+    const float3& p2 = triangle.p2;
+    const float3& p3 = triangle.p3;
+
     // Optimization 1: if the point is outside the bounding box of the triangle, we can skip it
-    float xMin = fmin(v1.position.x, fmin(v2.position.x, v3.position.x));
-    float xMax = fmax(v1.position.x, fmax(v2.position.x, v3.position.x));
-    float yMin = fmin(v1.position.y, fmin(v2.position.y, v3.position.y));
-    float yMax = fmax(v1.position.y, fmax(v2.position.y, v3.position.y));
+    float xMin = fmin(p1.x, fmin(p2.x, p3.x));
+    float xMax = fmax(p1.x, fmax(p2.x, p3.x));
+    float yMin = fmin(p1.y, fmin(p2.y, p3.y));
+    float yMax = fmax(p1.y, fmax(p2.y, p3.y));
 
     // Convert to pixel space
     int xMinPixelSpace = Renderer::ToPixelSpace(xMin, buffer.GetWidth());
@@ -97,22 +469,48 @@ static void DrawTriangle(Buffer& buffer, Vertex v1, Vertex v2, Vertex v3, Vertex
     int yMaxPixelSpace = Renderer::ToPixelSpace(yMax, buffer.GetHeight());
 
     // Clamp to buffer size
-    xMinPixelSpace = (int)fmax(xMinPixelSpace, 0);
-    xMaxPixelSpace = (int)fmin(xMaxPixelSpace, buffer.GetWidth());
-    yMinPixelSpace = (int)fmax(yMinPixelSpace, 0);
-    yMaxPixelSpace = (int)fmin(yMaxPixelSpace, buffer.GetHeight());
+    triangle.xMin = (int)fmax(xMinPixelSpace, 0);
+    triangle.xMax = (int)fmin(xMaxPixelSpace, buffer.GetWidth());
+    triangle.yMin = (int)fmax(yMinPixelSpace, 0);
+    triangle.yMax = (int)fmin(yMaxPixelSpace, buffer.GetHeight());
+
+    return triangle.xMin < triangle.xMax && triangle.yMin < triangle.yMax;
+}
+
+// Where a draw reports its work when statistics are collected, null otherwise
+struct StatisticsTarget
+{
+    Renderer::Counters* counters;
+    uint16_t* testCounts; // per pixel, row by row
+    uint16_t* shadeCounts;
+    int width;
+};
+
+// Pass and Features are fixed per draw, see SelectDrawTriangle. DepthOnly draws use no features.
+template <Renderer::Pass Pass, unsigned Features>
+static void DrawTriangle(Buffer& buffer, const Triangle& triangle, int tileX, int tileY, const DrawConstants& constants, const Texture* texture, const StatisticsTarget& statistics)
+{
+    const float3& p1 = triangle.p1;
+    const float3& p2 = triangle.p2;
+    const float3& p3 = triangle.p3;
+    const Vertex& v1 = *triangle.v1;
+    const Vertex& v2 = *triangle.v2;
+    const Vertex& v3 = *triangle.v3;
+
+    // Only the part of the bounding box that falls into this tile
+    int xMinPixelSpace = std::max(triangle.xMin, tileX * TileSize);
+    int xMaxPixelSpace = std::min(triangle.xMax, (tileX + 1) * TileSize);
+    int yMinPixelSpace = std::max(triangle.yMin, tileY * TileSize);
+    int yMaxPixelSpace = std::min(triangle.yMax, (tileY + 1) * TileSize);
 
     // Transform the triangle to pixel space from canonical space
     // This allows us to operate on integer values, and does not introduce artifacts caused by floating point precision
-    int pv1x = Renderer::ToPixelSpace(v1.position.x, buffer.GetWidth());
-    int pv1y = Renderer::ToPixelSpace(v1.position.y, buffer.GetHeight());
-    int pv1z = (int)v1.position.z;
-    int pv2x = Renderer::ToPixelSpace(v2.position.x, buffer.GetWidth());
-    int pv2y = Renderer::ToPixelSpace(v2.position.y, buffer.GetHeight());
-    int pv2z = (int)v2.position.z;
-    int pv3x = Renderer::ToPixelSpace(v3.position.x, buffer.GetWidth());
-    int pv3y = Renderer::ToPixelSpace(v3.position.y, buffer.GetHeight());
-    int pv3z = (int)v3.position.z;
+    int pv1x = Renderer::ToPixelSpace(p1.x, buffer.GetWidth());
+    int pv1y = Renderer::ToPixelSpace(p1.y, buffer.GetHeight());
+    int pv2x = Renderer::ToPixelSpace(p2.x, buffer.GetWidth());
+    int pv2y = Renderer::ToPixelSpace(p2.y, buffer.GetHeight());
+    int pv3x = Renderer::ToPixelSpace(p3.x, buffer.GetWidth());
+    int pv3y = Renderer::ToPixelSpace(p3.y, buffer.GetHeight());
 
     // Optimization 2: compute consts outside the loop (and it will help us with interpolation)
     int dx12 = pv1x - pv2x;
@@ -137,74 +535,253 @@ static void DrawTriangle(Buffer& buffer, Vertex v1, Vertex v2, Vertex v3, Vertex
     //assert((topleft12 && topleft23 && topleft31) == false); // 3 can't be true
     //assert((topleft12 || topleft23 || topleft31) == true); // at least 1 must be true
 
-    for (int y = yMinPixelSpace; y < yMaxPixelSpace; y++)
+    // Attributes are interpolated linearly in screen space, so their derivatives are the same for every pixel
+    // of the triangle, exactly what differencing the pixels of a 2x2 quad would give. They select the mip level.
+    float lod = 0.0f;
+    if ((Features & ShadeTexture) && Pass != Renderer::Pass::DepthOnly)
+    {
+        const float denominator1 = (float)(dy23 * dx13 + dx32 * dy13);
+        const float denominator2 = (float)(dy31 * dx23 + dx13 * dy23);
+        const float dLambda1dx = dy23 / denominator1;
+        const float dLambda1dy = dx32 / denominator1;
+        const float dLambda2dx = dy31 / denominator2;
+        const float dLambda2dy = dx13 / denominator2;
+
+        // In texels of the full resolution level
+        const float dudx = ((v1.u - v3.u) * dLambda1dx + (v2.u - v3.u) * dLambda2dx) * texture->GetWidth();
+        const float dudy = ((v1.u - v3.u) * dLambda1dy + (v2.u - v3.u) * dLambda2dy) * texture->GetWidth();
+        const float dvdx = ((v1.v - v3.v) * dLambda1dx + (v2.v - v3.v) * dLambda2dx) * texture->GetHeight();
+        const float dvdy = ((v1.v - v3.v) * dLambda1dy + (v2.v - v3.v) * dLambda2dy) * texture->GetHeight();
+
+        const float texelsPerPixel = fmax(sqrt(dudx * dudx + dvdx * dvdx), sqrt(dudy * dudy + dvdy * dvdy));
+        lod = texelsPerPixel > 0.0f ? log2f(texelsPerPixel) : 0.0f;
+    }
+
+    // Kept in locals and handed to the statistics once per triangle
+    uint64_t blocksTested = 0;
+    uint64_t blocksOccluded = 0;
+    uint64_t pixelsTested = 0;
+    uint64_t pixelsPassed = 0;
+    uint64_t pixelsShaded = 0;
+
+    // Returns true if the depth buffer was written
+    auto shadePixel = [&](int x, int y) -> bool
+    {
+        // Compute barycentric coordinates (l1 + l2 + l3 = 1)
+        float lambda1 = (dy23 * (x - pv3x) + dx32 * (y - pv3y)) / (float)(dy23 * dx13 + dx32 * dy13);
+        float lambda2 = (dy31 * (x - pv3x) + dx13 * (y - pv3y)) / (float)(dy31 * dx23 + dx13 * dy23);
+        float lambda3 = 1.0f - lambda1 - lambda2;
+        assert(lambda1 >= -0.00001 && lambda1 <= 1.00001);
+        assert(lambda2 >= -0.00001 && lambda2 <= 1.00001);
+        assert(lambda3 >= -0.00001 && lambda3 <= 1.00001);
+
+        // Compute depth based on barycentric coordinates
+        float depth = lambda1 * p1.z + lambda2 * p2.z + lambda3 * p3.z;
+
+        // Early depth test, so hidden pixels are never shaded
+        float& storedDepth = buffer.DepthAt(x, y);
+        const bool visible = Pass == Renderer::Pass::ShadeVisible ? depth == storedDepth : depth < storedDepth;
+        pixelsTested++;
+        if (statistics.testCounts != nullptr)
+        {
+            statistics.testCounts[y * statistics.width + x]++;
+        }
+        if (visible == false)
+        {
+            return false;
+        }
+        pixelsPassed++;
+
+        if (Pass == Renderer::Pass::DepthOnly)
+        {
+            storedDepth = depth;
+            return true;
+        }
+
+        // interpolate vertex color (when using vertex colors - currently, I'm not)
+        // uint8_t red     = static_cast<uint8_t>((v1.color.r * 255.0f * lambda1) + (v2.color.r * 255.0f * lambda2) + (v3.color.r * 255.0f * lambda3));
+        // uint8_t green   = static_cast<uint8_t>((v1.color.g * 255.0f * lambda1) + (v2.color.g * 255.0f * lambda2) + (v3.color.g * 255.0f * lambda3));
+        // uint8_t blue    = static_cast<uint8_t>((v1.color.b * 255.0f * lambda1) + (v2.color.b * 255.0f * lambda2) + (v3.color.b * 255.0f * lambda3));
+        // uint32_t color = (0xff << 24) | (red << 16) | (green << 8) | blue;
+
+        // Compute fragment color
+        float3 fragNormal = (v1.normal * lambda1 + v2.normal * lambda2 + v3.normal * lambda3).Normalized();
+        float3 fragPosition = v1.position * lambda1 + v2.position * lambda2 + v3.position * lambda3;
+        float3 initialFragColor;
+        if (Features & ShadeTexture)
+        {
+            float u = v1.u * lambda1 + v2.u * lambda2 + v3.u * lambda3;
+            float v = v1.v * lambda1 + v2.v * lambda2 + v3.v * lambda3;
+            initialFragColor = texture->Sample(u, v, lod);
+        }
+        else
+        {
+            initialFragColor = (v1.color * lambda1 + v2.color * lambda2 + v3.color * lambda3).Normalized();
+        }
+        Vertex fragment {fragPosition, fragNormal, initialFragColor};
+        const LightClusters::Lights pointLights = (Features & ShadePointLights) ? constants.lightClusters->At(x, y, depth) : LightClusters::Lights();
+        float3 finalFragColor = GetVertexColor<Features>(fragment, constants, pointLights);
+        uint8_t red     = static_cast<uint8_t>(finalFragColor.r * 255.0f);
+        uint8_t green   = static_cast<uint8_t>(finalFragColor.g * 255.0f);
+        uint8_t blue    = static_cast<uint8_t>(finalFragColor.b * 255.0f);
+        uint32_t color = (0xff << 24) | (red << 16) | (green << 8) | blue;
+
+        buffer.ColorAt(x, y) = color;
+        storedDepth = depth;
+        pixelsShaded++;
+        if (statistics.shadeCounts != nullptr)
+        {
+            statistics.shadeCounts[y * statistics.width + x]++;
+        }
+        return Pass == Renderer::Pass::Full;
+    };
+
+    // Edge functions written as value = stepX * x + stepY * y + constant. The top-left rule is folded in as a bias:
+    // an edge that is not top-left has to be > 0, which for integers is the same as value - 1 >= 0.
+    const int stepX[3] = { -dy12, -dy23, -dy31 };
+    const int stepY[3] = { dx12, dx23, dx31 };
+    const int constant[3] = {
+        dy12 * pv1x - dx12 * pv1y - (topleft12 ? 0 : 1),
+        dy23 * pv2x - dx23 * pv2y - (topleft23 ? 0 : 1),
+        dy31 * pv3x - dx31 * pv3y - (topleft31 ? 0 : 1),
+    };
+
+    // Walk the bounding box in blocks aligned to the block grid. The edge functions are linear, so their extremes over a block
+    // are at its corners: blocks that are outside of any edge are skipped, blocks inside all edges are filled without testing,
+    // and only blocks crossed by an edge are tested row by row.
+    for (int blockY = yMinPixelSpace - yMinPixelSpace % BlockSize; blockY < yMaxPixelSpace; blockY += BlockSize)
     {
-        for (int x = xMinPixelSpace; x < xMaxPixelSpace; x++)
+        for (int blockX = xMinPixelSpace - xMinPixelSpace % BlockSize; blockX < xMaxPixelSpace; blockX += BlockSize)
         {
-            // Edge functions
-            int tmp12 = (dx12 * (y - pv1y) - dy12 * (x - pv1x));
-            int tmp23 = (dx23 * (y - pv2y) - dy23 * (x - pv2x));
-            int tmp31 = (dx31 * (y - pv3y) - dy31 * (x - pv3x));
+            // Part of the block inside the bounding box (max exclusive)
+            const int x0 = std::max(blockX, xMinPixelSpace);
+            const int x1 = std::min(blockX + BlockSize, xMaxPixelSpace);
+            const int y0 = std::max(blockY, yMinPixelSpace);
+            const int y1 = std::min(blockY + BlockSize, yMaxPixelSpace);
 
-            bool belongsToTriangle =
-                (topleft12 ? tmp12 >= 0 : tmp12 > 0) &&
-                (topleft23 ? tmp23 >= 0 : tmp23 > 0) &&
-                (topleft31 ? tmp31 >= 0 : tmp31 > 0);
+            bool outside = false;
+            bool inside = true;
+            for (int e = 0; e < 3; e++)
+            {
+                const int minValue = constant[e] + stepX[e] * (stepX[e] > 0 ? x0 : x1 - 1) + stepY[e] * (stepY[e] > 0 ? y0 : y1 - 1);
+                const int maxValue = constant[e] + stepX[e] * (stepX[e] > 0 ? x1 - 1 : x0) + stepY[e] * (stepY[e] > 0 ? y1 - 1 : y0);
+                outside |= maxValue < 0;
+                inside &= minValue >= 0;
+            }
 
-            if (belongsToTriangle == false)
+            if (outside)
             {
                 continue;
             }
 
-            // Compute barycentric coordinates (l1 + l2 + l3 = 1)
-            float lambda1 = (dy23 * (x - pv3x) + dx32 * (y - pv3y)) / (float)(dy23 * dx13 + dx32 * dy13);
-            float lambda2 = (dy31 * (x - pv3x) + dx13 * (y - pv3y)) / (float)(dy31 * dx23 + dx13 * dy23);
-            float lambda3 = 1.0f - lambda1 - lambda2;
-            assert(lambda1 >= -0.00001 && lambda1 <= 1.00001);
-            assert(lambda2 >= -0.00001 && lambda2 <= 1.00001);
-            assert(lambda3 >= -0.00001 && lambda3 <= 1.00001);
-
-            // interpolate vertex color (when using vertex colors - currently, I'm not)
-            // uint8_t red     = static_cast<uint8_t>((v1.color.r * 255.0f * lambda1) + (v2.color.r * 255.0f * lambda2) + (v3.color.r * 255.0f * lambda3));
-            // uint8_t green   = static_cast<uint8_t>((v1.color.g * 255.0f * lambda1) + (v2.color.g * 255.0f * lambda2) + (v3.color.g * 255.0f * lambda3));
-            // uint8_t blue    = static_cast<uint8_t>((v1.color.b * 255.0f * lambda1) + (v2.color.b * 255.0f * lambda2) + (v3.color.b * 255.0f * lambda3));
-            // uint32_t color = (0xff << 24) | (red << 16) | (green << 8) | blue;
-
-            // Compute fragment color
-            float3 fragNormal = (untransformedV1.normal * lambda1 + untransformedV2.normal * lambda2 + untransformedV3.normal * lambda3).Normalized();
-            float3 fragPosition = (untransformedV1.position * lambda1 + untransformedV2.position * lambda2 + untransformedV3.position * lambda3).Normalized();
-            float3 initialFragColor;
-            if (texture != nullptr) 
+            // Hi-Z: skip the block when everything in it is already nearer than the whole triangle
+            blocksTested++;
+            if (triangle.minDepth > buffer.HiZAt(blockX / BlockSize, blockY / BlockSize))
             {
-                float u = v1.u * lambda1 + v2.u * lambda2 + v3.u * lambda3;
-                float v = v1.v * lambda1 + v2.v * lambda2 + v3.v * lambda3;
-                uint32_t sampledColor = SampleTexture(texture, u, v);
-                float red   = ((sampledColor & 0x00ff0000) >> 16) / 255.0f;
-                float green = ((sampledColor & 0x0000ff00) >> 8)  / 255.0f;
-                float blue  = ((sampledColor & 0x000000ff) >> 0)  / 255.0f;
-                initialFragColor = float3(red, green, blue);
+                blocksOccluded++;
+                continue;
             }
-            else
+
+            bool wroteDepth = false;
+            if (inside)
             {
-                initialFragColor = (untransformedV1.color * lambda1 + untransformedV2.color * lambda2 + untransformedV3.color * lambda3).Normalized();
+                for (int y = y0; y < y1; y++)
+                {
+                    for (int x = x0; x < x1; x++)
+                    {
+                        wroteDepth |= shadePixel(x, y);
+                    }
+                }
             }
-            Vertex fragment {fragPosition, fragNormal, initialFragColor};
-            float3 finalFragColor = GetVertexColor(fragment, transform, cameraPosition, directionalLight, pointLights, spotLight);
-            uint8_t red     = static_cast<uint8_t>(finalFragColor.r * 255.0f);
-            uint8_t green   = static_cast<uint8_t>(finalFragColor.g * 255.0f);
-            uint8_t blue    = static_cast<uint8_t>(finalFragColor.b * 255.0f);
-            uint32_t color = (0xff << 24) | (red << 16) | (green << 8) | blue;
+            else
+            {
+                // Partial block: edge values at the start of each row are stepped down from the previous row
+                Coverage::Edges edges;
+                for (int e = 0; e < 3; e++)
+                {
+                    edges.value[e] = stepX[e] * x0 + stepY[e] * y0 + constant[e];
+                    edges.stepX[e] = stepX[e];
+                }
 
-            // Compute depth based on barycentric coordinates
-            float depth = lambda1 * v1.position.z + lambda2 * v2.position.z + lambda3 * v3.position.z;
+                const uint32_t rowMask = (1u << (x1 - x0)) - 1;
+                for (int y = y0; y < y1; y++)
+                {
+                    uint32_t mask = Coverage::SpanMask(edges) & rowMask;
+                    for (int i = 0; mask != 0; i++, mask >>= 1)
+                    {
+                        if (mask & 1)
+                        {
+                            wroteDepth |= shadePixel(x0 + i, y);
+                        }
+                    }
 
-            if (depth < buffer.DepthAt(x, y))
+                    for (int e = 0; e < 3; e++)
+                    {
+                        edges.value[e] += stepY[e];
+                    }
+                }
+            }
+
+            if (wroteDepth)
             {
-                buffer.ColorAt(x, y) = color;
-                buffer.DepthAt(x, y) = depth;
+                buffer.UpdateHiZ(blockX / BlockSize, blockY / BlockSize);
             }
         }
     }
+
+    if (statistics.counters != nullptr)
+    {
+        statistics.counters->blocksTested += blocksTested;
+        statistics.counters->blocksOccluded += blocksOccluded;
+        statistics.counters->pixelsTested += pixelsTested;
+        statistics.counters->pixelsPassed += pixelsPassed;
+        statistics.counters->pixelsShaded += pixelsShaded;
+    }
+}
+
+typedef void (*DrawTriangleFunction)(Buffer& buffer, const Triangle& triangle, int tileX, int tileY, const DrawConstants& constants, const Texture* texture, const StatisticsTarget& statistics);
+
+template <Renderer::Pass Pass, unsigned... Features>
+static DrawTriangleFunction SelectShadedDrawTriangle(unsigned features, std::integer_sequence<unsigned, Features...>)
+{
+    static const DrawTriangleFunction functions[] = { &DrawTriangle<Pass, Features>... };
+    return functions[features];
+}
+
+// The raster loop compiled for this pass and the features the draw needs
+static DrawTriangleFunction SelectDrawTriangle(Renderer::Pass pass, const DrawConstants& constants, const Texture* texture)
+{
+    const float3& spotLightColor = constants.spotLightColor;
+
+    unsigned features = 0;
+    if (texture != nullptr)
+    {
+        features |= ShadeTexture;
+    }
+    if (constants.material.specularIntensity != 0.0f)
+    {
+        features |= ShadeSpecular;
+    }
+    if (spotLightColor.r != 0.0f || spotLightColor.g != 0.0f || spotLightColor.b != 0.0f)
+    {
+        features |= ShadeSpotLight;
+    }
+    if (constants.lightClusters->Empty() == false)
+    {
+        features |= ShadePointLights;
+    }
+
+    const std::make_integer_sequence<unsigned, ShadingPermutations> permutations;
+    switch (pass)
+    {
+    case Renderer::Pass::Full:
+        return SelectShadedDrawTriangle<Renderer::Pass::Full>(features, permutations);
+    case Renderer::Pass::ShadeVisible:
+        return SelectShadedDrawTriangle<Renderer::Pass::ShadeVisible>(features, permutations);
+    case Renderer::Pass::DepthOnly:
+    default:
+        return &DrawTriangle<Renderer::Pass::DepthOnly, 0>;
+    }
 }
 
 static float3 VisualizeNormal(const float3& normal)
@@ -217,26 +794,435 @@ static float3 VisualizeNormal(const float3& normal)
     );
 }
 
-void Renderer::DrawMesh(Buffer& buffer, const Mesh& mesh, const Transform& transform, const Camera& camera, const DirectionalLight& directionalLight, const std::vector<PointLight>& pointLights, const SpotLight& spotLight)
+static void GetBoxCorners(const BoundingBox& box, float3 (&corners)[8])
+{
+    for (int i = 0; i < 8; i++)
+    {
+        corners[i] = float3(
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z);
+    }
+}
+
+// Tests the mesh bounds against the left, right, bottom, top and near planes. Nothing limits the far side when rasterizing,
+// so there is no far plane either. The planes are taken from the object to clip space matrix, so the test happens in object space.
+static bool IsOutsideFrustum(const Mesh& mesh, const float4x4& objectToProjection)
+{
+    const float4& r0 = objectToProjection.row0;
+    const float4& r1 = objectToProjection.row1;
+    const float4& r3 = objectToProjection.row3;
+
+    // -w <= x <= w, -w <= y <= w, w >= near
+    const float4 planes[5] = {
+        r3 + r0,
+        r3 - r0,
+        r3 + r1,
+        r3 - r1,
+        r3 - float4{0, 0, 0, Camera::NearPlane},
+    };
+
+    // Cheap sphere test first
+    const BoundingSphere& sphere = mesh.boundingSphere;
+    for (const float4& plane : planes)
+    {
+        const float3 normal(plane);
+        const float distance = float3::Dot(normal, sphere.center) + plane.w;
+        if (distance < -sphere.radius * normal.Magnitude())
+        {
+            return true;
+        }
+    }
+
+    // The box is tighter, outside if all of its corners are outside of the same plane
+    float3 corners[8];
+    GetBoxCorners(mesh.boundingBox, corners);
+    for (const float4& plane : planes)
+    {
+        bool allOutside = true;
+        for (const float3& corner : corners)
+        {
+            allOutside &= float3::Dot(float3(plane), corner) + plane.w < 0;
+        }
+
+        if (allOutside)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Tests the screen space bounds of the mesh against the Hi-Z buffer
+static bool IsOccluded(const Buffer& buffer, const Mesh& mesh, const float4x4& objectToProjection)
+{
+    float3 corners[8];
+    GetBoxCorners(mesh.boundingBox, corners);
+
+    float3 boundsMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    float3 boundsMax = -boundsMin;
+    for (const float3& corner : corners)
+    {
+        const float4 clipPosition = objectToProjection * corner;
+
+        // Bounds can't be projected when part of the box is behind the camera
+        if (clipPosition.w < Camera::NearPlane)
+        {
+            return false;
+        }
+
+        const float3 position = float3(clipPosition) / clipPosition.w;
+        boundsMin = float3(fmin(boundsMin.x, position.x), fmin(boundsMin.y, position.y), fmin(boundsMin.z, position.z));
+        boundsMax = float3(fmax(boundsMax.x, position.x), fmax(boundsMax.y, position.y), fmax(boundsMax.z, position.z));
+    }
+
+    return buffer.IsOccluded(
+        Renderer::ToPixelSpace(boundsMin.x, buffer.GetWidth()), Renderer::ToPixelSpace(boundsMin.y, buffer.GetHeight()),
+        Renderer::ToPixelSpace(boundsMax.x, buffer.GetWidth()), Renderer::ToPixelSpace(boundsMax.y, buffer.GetHeight()),
+        NearestDepth(boundsMin.z));
+}
+
+// statistics and drawStatistics are either both null or both set, drawStatistics being the entry of the draw in statistics
+static void ExecuteDraw(Buffer& buffer, const Renderer::DrawCommand& draw, const DrawConstants& constants, Renderer::Pass pass, 
+    Renderer::Statistics* statistics, Renderer::DrawStatistics* drawStatistics)
 {
-    for (const int3& triangle : mesh.indices)
+    const Mesh& mesh = *draw.mesh;
+    const Renderer::CullMode cullMode = draw.cullMode;
+
+    // Counts go to a scratch copy when statistics are off, so the counting code doesn't need to check
+    Renderer::Counters unusedCounters;
+    Renderer::Counters& counters = drawStatistics != nullptr ? drawStatistics->counters : unusedCounters;
+
+    PROFILE_SCOPE("Draw");
+
+    // Adds the time since the last lap to a stage of the statistics and to the trace
+    const bool profiling = Profiler::IsRecording();
+    int64_t lapStart = drawStatistics != nullptr || profiling ? Profiler::Now() : 0;
+    auto lap = [&](Renderer::Stage stage, const char* name)
+    {
+        if (drawStatistics == nullptr && profiling == false)
+        {
+            return;
+        }
+
+        const int64_t now = Profiler::Now();
+        if (drawStatistics != nullptr)
+        {
+            drawStatistics->seconds[(int)stage] += (now - lapStart) * 1e-9;
+        }
+        if (profiling)
+        {
+            Profiler::Record(name, lapStart, now);
+        }
+        lapStart = now;
+    };
+
+    const float4x4 objectToProjection = constants.worldToProjection * constants.objectToWorld;
+
+    // Whole draw culling, before any vertex is processed
+    counters.draws++;
+    if (IsOutsideFrustum(mesh, objectToProjection))
+    {
+        counters.drawsFrustumCulled++;
+        return;
+    }
+    if (IsOccluded(buffer, mesh, objectToProjection))
+    {
+        counters.drawsOccluded++;
+        return;
+    }
+
+    const GuardBand guardBand = { GuardBandPixels / (0.5f * buffer.GetWidth()), GuardBandPixels / (0.5f * buffer.GetHeight()) };
+
+    // Vertex stage: every mesh vertex is transformed once, triangles only index into the result.
+    // Reads only the position stream, the rest of the vertex is needed only when shading.
+    const AlignedVector<float3>& positions = mesh.streams.positions;
+    assert(positions.size() == mesh.vertices.size() && "Mesh::RebuildStreams was not called");
+    std::vector<ProcessedVertex> processedVertices(positions.size());
+    for (size_t i = 0; i < positions.size(); i++)
     {
-        Vertex v1 = mesh.vertices[triangle.a];
-        Vertex v2 = mesh.vertices[triangle.b];
-        Vertex v3 = mesh.vertices[triangle.c];
+        ProcessedVertex& processed = processedVertices[i];
+        processed.clipPosition = objectToProjection * positions[i];
+        processed.position = float3(processed.clipPosition) / processed.clipPosition.w; // Perspective division
+        processed.outcode = ComputeOutcode(processed.clipPosition, guardBand);
+    }
+    lap(Renderer::Stage::Vertex, "Vertex stage");
+
+    // Triangle assembly and setup
+    std::vector<Triangle> triangles;
+    triangles.reserve(mesh.indices.size());
+
+    auto setupTriangle = [&](const float3& p1, const float3& p2, const float3& p3, const Vertex* v1, const Vertex* v2, const Vertex* v3)
+    {
+        Triangle triangle;
+        triangle.p1 = p1;
+        triangle.p2 = p2;
+        triangle.p3 = p3;
 
         // for shading the vertex needs to not be transformed, but for finding pixel on the screen it needs to be
-        Vertex untransformedV1 = v1;
-        Vertex untransformedV2 = v2;
-        Vertex untransformedV3 = v3;
+        triangle.v1 = v1;
+        triangle.v2 = v2;
+        triangle.v3 = v3;
+
+        if (SetupTriangle(triangle, buffer, cullMode) == false)
+        {
+            counters.trianglesFacingCulled++;
+            return;
+        }
+
+        triangle.minDepth = NearestDepth(fmin(triangle.p1.z, fmin(triangle.p2.z, triangle.p3.z)));
+        if (buffer.IsOccluded(triangle.xMin, triangle.yMin, triangle.xMax, triangle.yMax, triangle.minDepth))
+        {
+            counters.trianglesOccluded++;
+            return;
+        }
+
+        counters.trianglesRasterized++;
+        triangles.push_back(triangle);
+    };
+
+    // Vertices created by clipping, a deque so triangles can point at them
+    std::deque<Vertex> generatedVertices;
+
+    auto assembleTriangle = [&](uint32_t index1, uint32_t index2, uint32_t index3)
+    {
+        const ProcessedVertex& processed1 = processedVertices[index1];
+        const ProcessedVertex& processed2 = processedVertices[index2];
+        const ProcessedVertex& processed3 = processedVertices[index3];
 
-        Mesh::TransformVertex(v1, transform, camera, buffer.GetAspectRatio());
-        Mesh::TransformVertex(v2, transform, camera, buffer.GetAspectRatio());
-        Mesh::TransformVertex(v3, transform, camera, buffer.GetAspectRatio());
+        // Completely outside of one plane
+        counters.trianglesSubmitted++;
+        if (processed1.outcode & processed2.outcode & processed3.outcode)
+        {
+            counters.trianglesFrustumCulled++;
+            return;
+        }
+
+        // Most triangles fit into the guard band and go to the rasterizer as they are
+        if (((processed1.outcode | processed2.outcode | processed3.outcode) & ClippingPlanes) == 0)
+        {
+            setupTriangle(processed1.position, processed2.position, processed3.position, &mesh.vertices[index1], &mesh.vertices[index2], &mesh.vertices[index3]);
+            return;
+        }
 
-        DrawTriangle(buffer, v1, v2, v3, untransformedV1, untransformedV2, untransformedV3, transform, 
-            camera.position, directionalLight, pointLights, spotLight, mesh.texture);
+        ClipVertex polygon[MaxClipVertices] = {
+            { processed1.clipPosition, &mesh.vertices[index1] },
+            { processed2.clipPosition, &mesh.vertices[index2] },
+            { processed3.clipPosition, &mesh.vertices[index3] },
+        };
+        const uint32_t planes = (processed1.outcode | processed2.outcode | processed3.outcode) & ClippingPlanes;
+        counters.trianglesClipped++;
+        const int count = ClipPolygon(polygon, 3, planes, guardBand, generatedVertices);
+
+        // Triangle fan, keeps the winding of the original triangle
+        for (int i = 1; i + 1 < count; i++)
+        {
+            setupTriangle(
+                float3(polygon[0].clipPosition) / polygon[0].clipPosition.w,
+                float3(polygon[i].clipPosition) / polygon[i].clipPosition.w,
+                float3(polygon[i + 1].clipPosition) / polygon[i + 1].clipPosition.w,
+                polygon[0].vertex, polygon[i].vertex, polygon[i + 1].vertex);
+        }
+    };
+
+    const VertexStreams& streams = mesh.streams;
+    for (size_t i = 0; i + 2 < streams.indices16.size(); i += 3)
+    {
+        assembleTriangle(streams.indices16[i], streams.indices16[i + 1], streams.indices16[i + 2]);
+    }
+    for (size_t i = 0; i + 2 < streams.indices32.size(); i += 3)
+    {
+        assembleTriangle(streams.indices32[i], streams.indices32[i + 1], streams.indices32[i + 2]);
+    }
+    lap(Renderer::Stage::Setup, "Triangle setup");
+
+    // Bin triangles into every tile their bounding box touches. Bins keep submission order,
+    // so each pixel sees the triangles in the same order as a serial loop would and the output is identical.
+    const int tilesX = (buffer.GetWidth() + TileSize - 1) / TileSize;
+    const int tilesY = (buffer.GetHeight() + TileSize - 1) / TileSize;
+    std::vector<std::vector<int>> bins(tilesX * tilesY);
+
+    for (int i = 0; i < (int)triangles.size(); i++)
+    {
+        const Triangle& triangle = triangles[i];
+        for (int tileY = triangle.yMin / TileSize; tileY <= (triangle.yMax - 1) / TileSize; tileY++)
+        {
+            for (int tileX = triangle.xMin / TileSize; tileX <= (triangle.xMax - 1) / TileSize; tileX++)
+            {
+                bins[tileY * tilesX + tileX].push_back(i);
+            }
+        }
+    }
+    lap(Renderer::Stage::Binning, "Binning");
+
+    // Every tile counts on its own, the counts are added up once all tiles are done
+    std::vector<Renderer::Counters> tileCounters(statistics != nullptr ? bins.size() : 0);
+
+    const DrawTriangleFunction drawTriangle = SelectDrawTriangle(pass, constants, draw.texture);
+    ThreadPool::Get().ParallelFor((int)bins.size(), [&](int tile)
+    {
+        if (bins[tile].empty())
+        {
+            return;
+        }
+
+        PROFILE_SCOPE("Raster and shade tile");
+
+        const int tileX = tile % tilesX;
+        const int tileY = tile / tilesX;
+        buffer.PrepareTile(tileX, tileY);
+
+        StatisticsTarget target = { nullptr, nullptr, nullptr, 0 };
+        if (statistics != nullptr)
+        {
+            target = { &tileCounters[tile], statistics->TestCounts(), statistics->ShadeCounts(), statistics->GetWidth() };
+        }
+
+        for (int i : bins[tile])
+        {
+            drawTriangle(buffer, triangles[i], tileX, tileY, constants, draw.texture, target);
+        }
+    });
+
+    for (const Renderer::Counters& tileCounts : tileCounters)
+    {
+        counters.Add(tileCounts);
+    }
+    lap(Renderer::Stage::Raster, "Raster");
+}
+
+void Renderer::DrawMesh(Buffer& buffer, const Mesh& mesh, const Transform& transform, const Camera& camera, const DirectionalLight& directionalLight, const std::vector<PointLight>& pointLights, const SpotLight& spotLight, Pass pass, CullMode cullMode, Statistics* statistics)
+{
+    const DrawCommand draw{ &mesh, transform, mesh.texture, Material(), cullMode };
+
+    LightClusters lightClusters;
+    lightClusters.Build(pointLights, camera, buffer.GetWidth(), buffer.GetHeight());
+    DrawConstants constants = BuildFrameConstants(camera, buffer.GetAspectRatio(), directionalLight, lightClusters, spotLight);
+    const float4x4 objectToWorld = transform.GetModelMatrix();
+    SetDrawConstants(constants, objectToWorld, objectToWorld.Inverse().Transposed(), draw.material);
+
+    DrawStatistics* drawStatistics = nullptr;
+    if (statistics != nullptr)
+    {
+        assert(statistics->GetWidth() == buffer.GetWidth() && "Statistics::Reset was not called for this buffer");
+        drawStatistics = &statistics->AddDraw(&mesh);
     }
+
+    ExecuteDraw(buffer, draw, constants, pass, statistics, drawStatistics);
+}
+
+Renderer::Frame::Frame(const Camera& camera, const DirectionalLight& directionalLight, const std::vector<PointLight>& pointLights, const SpotLight& spotLight)
+    : m_camera(camera), m_directionalLight(directionalLight), m_pointLights(pointLights), m_spotLight(spotLight)
+{
+}
+
+void Renderer::Frame::Submit(const Mesh& mesh, const Transform& transform, const Material& material, CullMode cullMode)
+{
+    Submit(mesh, transform, mesh.texture, material, cullMode);
+}
+
+void Renderer::Frame::Submit(const Mesh& mesh, const Transform& transform, const Texture* texture, const Material& material, CullMode cullMode)
+{
+    m_draws.push_back(DrawCommand{ &mesh, transform, texture, material, cullMode });
+}
+
+void Renderer::Flush(Buffer& buffer, Frame& frame)
+{
+    PROFILE_SCOPE("Frame");
+
+    Statistics* statistics = frame.statistics;
+    const bool profiling = Profiler::IsRecording();
+    const int64_t sortStart = statistics != nullptr || profiling ? Profiler::Now() : 0;
+    if (statistics != nullptr)
+    {
+        statistics->Reset(buffer.GetWidth(), buffer.GetHeight());
+    }
+
+    LightClusters lightClusters;
+    {
+        PROFILE_SCOPE("Light clusters");
+        lightClusters.Build(frame.m_pointLights, frame.m_camera, buffer.GetWidth(), buffer.GetHeight());
+    }
+    DrawConstants constants = BuildFrameConstants(frame.m_camera, buffer.GetAspectRatio(), frame.m_directionalLight, lightClusters, frame.m_spotLight);
+
+    struct SortedDraw
+    {
+        const DrawCommand* draw;
+        float4x4 objectToWorld;
+        float4x4 normalToWorld;
+        float viewDistance;
+        int distanceBucket;
+    };
+
+    std::vector<SortedDraw> sortedDraws;
+    sortedDraws.reserve(frame.m_draws.size());
+    for (const DrawCommand& draw : frame.m_draws)
+    {
+        SortedDraw sorted;
+        sorted.draw = &draw;
+        sorted.objectToWorld = draw.transform.GetModelMatrix();
+        sorted.normalToWorld = sorted.objectToWorld.Inverse().Transposed();
+
+        // Distance to the nearest point of the bounding sphere, so large objects around the camera go first
+        const float3& scale = draw.transform.scale;
+        const float3 center = sorted.objectToWorld * draw.mesh->boundingSphere.center;
+        const float radius = draw.mesh->boundingSphere.radius * fmax(fabs(scale.x), fmax(fabs(scale.y), fabs(scale.z)));
+        sorted.viewDistance = fmax((center - frame.m_camera.position).Magnitude() - radius, 0.0f);
+
+        // Draws at a similar distance (within a factor of about 1.4) are grouped by texture, so texture reads stay in cache
+        sorted.distanceBucket = (int)floor(2.0f * log2(fmax(sorted.viewDistance, Camera::NearPlane)));
+        sortedDraws.push_back(sorted);
+    }
+
+    std::stable_sort(sortedDraws.begin(), sortedDraws.end(), [](const SortedDraw& a, const SortedDraw& b)
+    {
+        if (a.distanceBucket != b.distanceBucket)
+        {
+            return a.distanceBucket < b.distanceBucket;
+        }
+        if (a.draw->texture != b.draw->texture)
+        {
+            return std::less<const Texture*>()(a.draw->texture, b.draw->texture);
+        }
+        return a.viewDistance < b.viewDistance;
+    });
+
+    // One entry per draw in drawing order, both passes of a depth prepass go into the same one
+    if (statistics != nullptr)
+    {
+        for (const SortedDraw& sorted : sortedDraws)
+        {
+            statistics->AddDraw(sorted.draw->mesh);
+        }
+        statistics->AddSeconds(Stage::Sort, (Profiler::Now() - sortStart) * 1e-9);
+    }
+    if (profiling)
+    {
+        Profiler::Record("Sort draws", sortStart, Profiler::Now());
+    }
+
+    auto executeAll = [&](Pass pass)
+    {
+        for (size_t i = 0; i < sortedDraws.size(); i++)
+        {
+            const SortedDraw& sorted = sortedDraws[i];
+            SetDrawConstants(constants, sorted.objectToWorld, sorted.normalToWorld, sorted.draw->material);
+            ExecuteDraw(buffer, *sorted.draw, constants, pass, statistics, statistics != nullptr ? &statistics->GetDraw(i) : nullptr);
+        }
+    };
+
+    if (frame.depthPrepass)
+    {
+        executeAll(Pass::DepthOnly);
+        executeAll(Pass::ShadeVisible);
+    }
+    else
+    {
+        executeAll(Pass::Full);
+    }
+
+    frame.Clear();
 }
 
 float Renderer::ToCanonicalSpace(int value, float limit)
@@ -1,17 +1,74 @@
 #pragma once
 
 class Buffer;
-class Mesh;
-struct DirectionalLight;
-struct Transform;
-struct PointLight;
-struct SpotLight;
-struct Camera;
+class Texture;
 
 #include <vector>
 
+#include "mesh.h"
+#include "light.h"
+#include "material.h"
+#include "statistics.h"
+
 namespace Renderer 
 {
+	// Which part of the work a draw does. For scenes with a lot of overdraw, draw every mesh with DepthOnly first
+	// and then every mesh again with ShadeVisible, so each pixel is shaded only once.
+	enum class Pass
+	{
+		Full,			// depth test, shading and depth write in one go
+		DepthOnly,		// only fills the depth buffer
+		ShadeVisible,	// only shades pixels whose depth matches the depth buffer
+	};
+
+	// Which triangles are skipped, based on their winding on screen
+	enum class CullMode
+	{
+		None,
+		Back,
+		Front,
+	};
+
+	struct DrawCommand
+	{
+		const Mesh* mesh;
+		Transform transform;
+		const Texture* texture;
+		Material material;
+		CullMode cullMode;
+	};
+
+	// Draws recorded for one frame. Nothing is drawn until the frame is flushed, which lets the renderer
+	// set up the camera and lights once and reorder the draws.
+	class Frame
+	{
+	public:
+		Frame(const Camera& camera, const DirectionalLight& directionalLight, const std::vector<PointLight>& pointLights, const SpotLight& spotLight);
+
+		// Uses the texture of the mesh
+		void Submit(const Mesh& mesh, const Transform& transform, const Material& material = Material(), CullMode cullMode = CullMode::Back);
+		void Submit(const Mesh& mesh, const Transform& transform, const Texture* texture, const Material& material = Material(), CullMode cullMode = CullMode::Back);
+		void Clear() { m_draws.clear(); }
+
+		// Draw everything with Pass::DepthOnly first and then with Pass::ShadeVisible
+		bool depthPrepass = false;
+		// When set, Flush resets it and fills it with the statistics of the frame
+		Statistics* statistics = nullptr;
+
+	private:
+		friend void Flush(Buffer& buffer, Frame& frame);
+
+		Camera m_camera;
+		DirectionalLight m_directionalLight;
+		std::vector<PointLight> m_pointLights;
+		SpotLight m_spotLight;
+		std::vector<DrawCommand> m_draws;
+	};
+
+	// Draws all draws of the frame, sorted front to back and grouped by texture, and clears the frame
+	void Flush(Buffer& buffer, Frame& frame);
+
+	// Draws a single mesh right away
 	void DrawMesh(
 		Buffer& buffer, 
 		const Mesh& mesh, 
@@ -19,7 +76,10 @@ namespace Renderer
 		const Camera& camera, 
 		const DirectionalLight& directionalLight, 
 		const std::vector<PointLight>& pointLights, 
-		const SpotLight& spotLight);
+		const SpotLight& spotLight,
+		Pass pass = Pass::Full,
+		CullMode cullMode = CullMode::Back,
+		Statistics* statistics = nullptr); // the draw is added to it, Reset it for every frame
 	float ToCanonicalSpace(int value, float limit);
 	int ToPixelSpace(float value, int limit);
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "sharedFrameRing.h"
+
+#include <cassert>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "counters in shared memory have to be lock free");
+
+size_t SharedFrameRing::HeaderSize(int slotCount)
+{
+	const size_t size = offsetof(Header, sequence) + sizeof(std::atomic<uint64_t>) * slotCount;
+	return (size + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+}
+
+SharedFrameRing::SharedFrameRing(const char* name, unsigned short width, unsigned short height, int slotCount)
+{
+	assert(slotCount >= 2 && "a reader needs one slot to read while the next frame is rendered");
+
+	const size_t frameSize = (size_t)width * height * sizeof(uint32_t);
+	const size_t slotStride = (frameSize + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+	const size_t size = HeaderSize(slotCount) + slotStride * slotCount;
+
+	void* memory = nullptr;
+#ifdef _WIN32
+	// Backed by the paging file, visible to other processes under the same name while a handle is open
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+	if (mapping == nullptr)
+	{
+		return;
+	}
+	m_mapping = mapping;
+
+	memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (memory == nullptr)
+	{
+		return;
+	}
+#else
+	// A leftover ring of an earlier run might have another size
+	shm_unlink(name);
+	const int file = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (file < 0)
+	{
+		return;
+	}
+	m_name.assign(name, name + strlen(name) + 1);
+
+	if (ftruncate(file, (off_t)size) != 0)
+	{
+		close(file);
+		return;
+	}
+
+	memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (memory == MAP_FAILED)
+	{
+		return;
+	}
+#endif
+
+	m_size = size;
+	m_header = static_cast<Header*>(memory);
+	m_header->width = width;
+	m_header->height = height;
+	m_header->slotCount = (uint32_t)slotCount;
+	m_header->slotStride = (uint32_t)slotStride;
+	new (&m_header->published) std::atomic<uint64_t>(0);
+	for (int slot = 0; slot < slotCount; slot++)
+	{
+		new (&m_header->sequence[slot]) std::atomic<uint64_t>(0);
+	}
+
+	uint8_t* slots = static_cast<uint8_t*>(memory) + HeaderSize(slotCount);
+	for (int slot = 0; slot < slotCount; slot++)
+	{
+		m_buffers.emplace_back(new Buffer(width, height, reinterpret_cast<uint32_t*>(slots + slotStride * slot)));
+	}
+
+	// Readers check the magic last, so they never see a half initialized header
+	m_header->version = Version;
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header->magic = Magic;
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+	// The buffers point into the mapping
+	m_buffers.clear();
+
+#ifdef _WIN32
+	if (m_header != nullptr)
+	{
+		UnmapViewOfFile(m_header);
+	}
+	if (m_mapping != nullptr)
+	{
+		CloseHandle(m_mapping);
+	}
+#else
+	if (m_header != nullptr)
+	{
+		munmap(m_header, m_size);
+	}
+	if (m_name.empty() == false)
+	{
+		shm_unlink(m_name.data());
+	}
+#endif
+}
+
+Buffer& SharedFrameRing::AcquireBuffer()
+{
+	assert(IsOpen());
+	assert(m_acquiredSlot == -1 && "the acquired buffer wasn't published");
+
+	m_acquiredSlot = (int)(m_published % m_header->slotCount);
+	std::atomic<uint64_t>& sequence = m_header->sequence[m_acquiredSlot];
+	sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	// The odd sequence number has to be visible before any pixel of the new frame
+	std::atomic_thread_fence(std::memory_order_release);
+
+	return *m_buffers[m_acquiredSlot];
+}
+
+void SharedFrameRing::Publish()
+{
+	assert(m_acquiredSlot != -1 && "no buffer was acquired");
+
+	std::atomic<uint64_t>& sequence = m_header->sequence[m_acquiredSlot];
+	sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	m_header->published.store(++m_published, std::memory_order_release);
+
+	m_acquiredSlot = -1;
+}
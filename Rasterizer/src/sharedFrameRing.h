@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "buffer.h"
+
+// Publishes rendered frames into a named shared memory ring that other processes can map and read without copies.
+// Frames are rendered straight into the shared slots: acquire a buffer, draw into it and publish it.
+//
+// Layout of the shared memory: a Header, then slotCount slots of width * height pixels (0xAARRGGBB, bottom row first),
+// each slot starting at a multiple of SlotAlignment. A reader takes slot (published - 1) % slotCount, copies or
+// consumes it and checks that its sequence number did not change meanwhile, otherwise the writer lapped it.
+class SharedFrameRing
+{
+public:
+	static constexpr uint32_t Magic = 0x47464b52; // "RKFG"
+	static constexpr uint32_t Version = 1;
+	static constexpr size_t SlotAlignment = 4096;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t slotCount;
+		uint32_t slotStride; // bytes from one slot to the next
+		// Number of frames published so far, the newest one is in slot (published - 1) % slotCount
+		std::atomic<uint64_t> published;
+		// Per slot: odd while the frame in it is being rendered, even once it is complete
+		std::atomic<uint64_t> sequence[1];
+	};
+
+	// name is a POSIX shared memory name like "/rasterizer", created or replaced by the ring
+	SharedFrameRing(const char* name, unsigned short width, unsigned short height, int slotCount = 3);
+	// Unmaps and removes the name, readers that still have it mapped keep their view
+	~SharedFrameRing();
+
+	SharedFrameRing(const SharedFrameRing&) = delete;
+	SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+	bool IsOpen() const { return m_header != nullptr; }
+
+	// Buffer rendering into the next slot, the slot is marked as being written until Publish
+	Buffer& AcquireBuffer();
+	void Publish();
+
+private:
+	static size_t HeaderSize(int slotCount);
+
+	Header* m_header = nullptr;
+	size_t m_size = 0;
+	std::vector<std::unique_ptr<Buffer>> m_buffers;
+	int m_acquiredSlot = -1;
+	uint64_t m_published = 0;
+#ifdef _WIN32
+	void* m_mapping = nullptr;
+#else
+	std::vector<char> m_name;
+#endif
+};
@@ -0,0 +1,136 @@
+#include "statistics.h"
+
+#include "buffer.h"
+
+#include <algorithm>
+#include <cassert>
+
+void Renderer::Counters::Add(const Counters& other)
+{
+	draws += other.draws;
+	drawsFrustumCulled += other.drawsFrustumCulled;
+	drawsOccluded += other.drawsOccluded;
+
+	trianglesSubmitted += other.trianglesSubmitted;
+	trianglesClipped += other.trianglesClipped;
+	trianglesFrustumCulled += other.trianglesFrustumCulled;
+	trianglesFacingCulled += other.trianglesFacingCulled;
+	trianglesOccluded += other.trianglesOccluded;
+	trianglesRasterized += other.trianglesRasterized;
+
+	blocksTested += other.blocksTested;
+	blocksOccluded += other.blocksOccluded;
+	pixelsTested += other.pixelsTested;
+	pixelsPassed += other.pixelsPassed;
+	pixelsShaded += other.pixelsShaded;
+	pixelsOverwritten += other.pixelsOverwritten;
+}
+
+void Renderer::Statistics::Reset(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+	m_draws.clear();
+	std::fill(m_seconds, m_seconds + (int)Stage::Count, 0.0);
+	m_testCounts.assign((size_t)width * height, 0);
+	m_shadeCounts.assign((size_t)width * height, 0);
+}
+
+Renderer::DrawStatistics& Renderer::Statistics::AddDraw(const Mesh* mesh)
+{
+	m_draws.emplace_back();
+	m_draws.back().mesh = mesh;
+	return m_draws.back();
+}
+
+Renderer::Counters Renderer::Statistics::GetTotals() const
+{
+	Counters totals;
+	for (const DrawStatistics& draw : m_draws)
+	{
+		totals.Add(draw.counters);
+	}
+
+	// Every shade of a pixel but the last one was wasted
+	for (uint16_t count : m_shadeCounts)
+	{
+		totals.pixelsOverwritten += count > 1 ? count - 1 : 0;
+	}
+
+	return totals;
+}
+
+double Renderer::Statistics::GetSeconds(Stage stage) const
+{
+	double seconds = m_seconds[(int)stage];
+	for (const DrawStatistics& draw : m_draws)
+	{
+		seconds += draw.seconds[(int)stage];
+	}
+	return seconds;
+}
+
+void Renderer::Statistics::WriteHeatmap(Buffer& destination, Heatmap heatmap) const
+{
+	assert(destination.GetWidth() == m_width && destination.GetHeight() == m_height);
+
+	static constexpr uint32_t Palette[] = {
+		0xff000000, // 0
+		0xff0000c0, // 1
+		0xff00c0c0, // 2
+		0xff00c000, // 3
+		0xffc0c000, // 4
+		0xffff8000, // 5
+		0xffff0000, // 6
+		0xffffffff, // 7 and more
+	};
+	constexpr int PaletteSize = sizeof(Palette) / sizeof(Palette[0]);
+
+	const std::vector<uint16_t>& counts = heatmap == Heatmap::Shaded ? m_shadeCounts : m_testCounts;
+	for (int y = 0; y < m_height; y++)
+	{
+		if (destination.GetLayout() == Buffer::Layout::Tiled)
+		{
+			for (int tileX = 0; tileX * Buffer::TileSize < m_width; tileX++)
+			{
+				destination.PrepareTile(tileX, y / Buffer::TileSize);
+			}
+		}
+
+		for (int x = 0; x < m_width; x++)
+		{
+			const int count = counts[(size_t)y * m_width + x];
+			destination.ColorAt(x, y) = Palette[std::min(count, PaletteSize - 1)];
+		}
+	}
+}
+
+void Renderer::Statistics::Print(FILE* output) const
+{
+	const Counters totals = GetTotals();
+
+	auto percent = [](uint64_t part, uint64_t whole) { return whole > 0 ? 100.0 * part / whole : 0.0; };
+
+	fprintf(output, "draws              %10llu  frustum culled %llu, occluded %llu\n",
+		(unsigned long long)totals.draws, (unsigned long long)totals.drawsFrustumCulled, (unsigned long long)totals.drawsOccluded);
+	fprintf(output, "triangles          %10llu  clipped %llu\n",
+		(unsigned long long)totals.trianglesSubmitted, (unsigned long long)totals.trianglesClipped);
+	fprintf(output, "  frustum culled   %10llu\n", (unsigned long long)totals.trianglesFrustumCulled);
+	fprintf(output, "  facing culled    %10llu\n", (unsigned long long)totals.trianglesFacingCulled);
+	fprintf(output, "  occluded         %10llu\n", (unsigned long long)totals.trianglesOccluded);
+	fprintf(output, "  rasterized       %10llu\n", (unsigned long long)totals.trianglesRasterized);
+	fprintf(output, "blocks             %10llu  %.1f%% skipped by Hi-Z\n",
+		(unsigned long long)totals.blocksTested, percent(totals.blocksOccluded, totals.blocksTested));
+	fprintf(output, "pixels tested      %10llu\n", (unsigned long long)totals.pixelsTested);
+	fprintf(output, "  passed depth     %10llu  %.1f%%\n", (unsigned long long)totals.pixelsPassed, percent(totals.pixelsPassed, totals.pixelsTested));
+	fprintf(output, "  shaded           %10llu\n", (unsigned long long)totals.pixelsShaded);
+	fprintf(output, "  overwritten      %10llu  %.1f%% of the shaded ones\n",
+		(unsigned long long)totals.pixelsOverwritten, percent(totals.pixelsOverwritten, totals.pixelsShaded));
+
+	static const char* const StageNames[] = { "sort", "vertex", "setup", "binning", "raster" };
+	static_assert(sizeof(StageNames) / sizeof(StageNames[0]) == (int)Stage::Count, "every stage needs a name");
+	for (int stage = 0; stage < (int)Stage::Count; stage++)
+	{
+		fprintf(output, "%-18s %10.3f ms\n", StageNames[stage], GetSeconds((Stage)stage) * 1000.0);
+	}
+}
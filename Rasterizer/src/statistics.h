@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+class Buffer;
+class Mesh;
+
+namespace Renderer
+{
+	// Work done by the pipeline stages. Triangles are counted once when read from the index buffer, every other
+	// triangle counter counts the triangles that come out of clipping, so they can add up to more than were submitted.
+	// With a depth prepass every draw goes through the pipeline twice and is counted twice.
+	struct Counters
+	{
+		uint64_t draws = 0;
+		uint64_t drawsFrustumCulled = 0;	// bounding box outside of the view
+		uint64_t drawsOccluded = 0;			// bounding box behind the Hi-Z buffer
+
+		uint64_t trianglesSubmitted = 0;
+		uint64_t trianglesClipped = 0;		// crossed the near plane or the guard band
+		uint64_t trianglesFrustumCulled = 0;	// completely outside of one view plane
+		uint64_t trianglesFacingCulled = 0;	// culled by winding, zero area or no pixels on screen
+		uint64_t trianglesOccluded = 0;		// bounding rectangle behind the Hi-Z buffer
+		uint64_t trianglesRasterized = 0;	// made it to the rasterizer
+
+		uint64_t blocksTested = 0;			// raster blocks overlapping a triangle
+		uint64_t blocksOccluded = 0;		// of those, skipped by the Hi-Z buffer
+		uint64_t pixelsTested = 0;			// covered pixels that were depth tested
+		uint64_t pixelsPassed = 0;			// passed the depth test
+		uint64_t pixelsShaded = 0;			// color written
+		uint64_t pixelsOverwritten = 0;		// shaded and later shaded again by another triangle, only known per frame
+
+		void Add(const Counters& other);
+	};
+
+	enum class Stage
+	{
+		Sort,		// per frame: sorting the draws
+		Vertex,		// transforming vertices
+		Setup,		// triangle assembly, clipping, culling and setup
+		Binning,	// sorting triangles into tiles
+		Raster,		// rasterization, depth test and shading
+		Count,
+	};
+
+	struct DrawStatistics
+	{
+		const Mesh* mesh = nullptr;
+		Counters counters;
+		double seconds[(int)Stage::Count] = {};
+	};
+
+	// Statistics of a frame, filled in by Flush (or DrawMesh) when one is given to it. Collecting them costs some time,
+	// so the timers of a frame with statistics are a bit higher than without.
+	class Statistics
+	{
+	public:
+		// Which per pixel count the heatmap shows
+		enum class Heatmap
+		{
+			Shaded,		// overdraw: how many times each pixel was shaded
+			Tested,		// how many times each pixel was depth tested, includes a depth prepass
+		};
+
+		// Forgets everything, the next draw starts a new frame
+		void Reset(int width, int height);
+
+		// Frame totals, pixelsOverwritten included
+		Counters GetTotals() const;
+		double GetSeconds(Stage stage) const;
+		const std::vector<DrawStatistics>& GetDraws() const { return m_draws; }
+
+		// Colors every pixel of the destination (same size as the frame) by its count:
+		// black 0, then blue, cyan, green, yellow, orange, red and white for 7 or more
+		void WriteHeatmap(Buffer& destination, Heatmap heatmap = Heatmap::Shaded) const;
+		void Print(FILE* output) const;
+
+		// Used by the renderer
+		DrawStatistics& AddDraw(const Mesh* mesh);
+		DrawStatistics& GetDraw(size_t index) { return m_draws[index]; }
+		void AddSeconds(Stage stage, double seconds) { m_seconds[(int)stage] += seconds; }
+		uint16_t* TestCounts() { return m_testCounts.data(); }
+		uint16_t* ShadeCounts() { return m_shadeCounts.data(); }
+		int GetWidth() const { return m_width; }
+
+	private:
+		int m_width = 0;
+		int m_height = 0;
+		std::vector<DrawStatistics> m_draws;
+		double m_seconds[(int)Stage::Count] = {};
+		std::vector<uint16_t> m_testCounts;
+		std::vector<uint16_t> m_shadeCounts;
+	};
+}
@@ -0,0 +1,209 @@
+#include "texture.h"
+
+#include "buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+static float3 ToColor(uint32_t texel)
+{
+    float red   = ((texel & 0x00ff0000) >> 16) / 255.0f;
+    float green = ((texel & 0x0000ff00) >> 8)  / 255.0f;
+    float blue  = ((texel & 0x000000ff) >> 0)  / 255.0f;
+
+    return float3(red, green, blue);
+}
+
+// Average of four texels, per channel and rounded
+static uint32_t Average(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        const uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) + ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+        result |= ((sum + 2) / 4) << shift;
+    }
+
+    return result;
+}
+
+static int CeilLog2(int value)
+{
+    int bits = 0;
+    while ((1 << bits) < value)
+    {
+        bits++;
+    }
+
+    return bits;
+}
+
+Texture::Texture(const Buffer& image, Layout layout)
+    : m_layout(layout)
+{
+    switch (layout)
+    {
+    case Layout::Tiled: m_sample = &Texture::SampleLayout<Layout::Tiled>; break;
+    case Layout::Morton: m_sample = &Texture::SampleLayout<Layout::Morton>; break;
+    default: m_sample = &Texture::SampleLayout<Layout::Linear>; break;
+    }
+
+    int width = image.GetWidth();
+    int height = image.GetHeight();
+    assert(width > 0 && height > 0 && "texture must not be empty");
+
+    // The mip chain is built row by row first and only then put into the requested layout
+    struct LinearLevel
+    {
+        int width;
+        int height;
+        size_t offset;
+    };
+    std::vector<LinearLevel> linearLevels;
+    std::vector<uint32_t> linear((size_t)width * height);
+
+    linearLevels.push_back(LinearLevel{ width, height, 0 });
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            linear[(size_t)y * width + x] = image.ColorAt(x, y);
+        }
+    }
+
+    // Every level is a 2x2 box filter of the previous one, down to a single texel.
+    // Odd sizes round down, the last row/column is clamped.
+    while (width > 1 || height > 1)
+    {
+        const LinearLevel source = linearLevels.back();
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+
+        const LinearLevel level{ width, height, linear.size() };
+        linear.resize(linear.size() + (size_t)width * height);
+        for (int y = 0; y < height; y++)
+        {
+            const int y0 = std::min(2 * y, source.height - 1);
+            const int y1 = std::min(2 * y + 1, source.height - 1);
+            for (int x = 0; x < width; x++)
+            {
+                const int x0 = std::min(2 * x, source.width - 1);
+                const int x1 = std::min(2 * x + 1, source.width - 1);
+                const uint32_t* texels = &linear[source.offset];
+                linear[level.offset + (size_t)y * width + x] = Average(
+                    texels[y0 * source.width + x0], texels[y0 * source.width + x1],
+                    texels[y1 * source.width + x0], texels[y1 * source.width + x1]);
+            }
+        }
+
+        linearLevels.push_back(level);
+    }
+
+    size_t offset = 0;
+    for (const LinearLevel& source : linearLevels)
+    {
+        Level level{ source.width, source.height, offset, (size_t)source.width * source.height, 0, 0 };
+        if (layout == Layout::Tiled)
+        {
+            level.tilesX = (source.width + TileSize - 1) / TileSize;
+            const int tilesY = (source.height + TileSize - 1) / TileSize;
+            level.size = (size_t)level.tilesX * tilesY * TileSize * TileSize;
+        }
+        else if (layout == Layout::Morton)
+        {
+            const int bitsX = CeilLog2(source.width);
+            const int bitsY = CeilLog2(source.height);
+            level.mortonBits = std::min(bitsX, bitsY);
+            level.size = (size_t)1 << (bitsX + bitsY);
+        }
+
+        m_levels.push_back(level);
+        offset += level.size;
+    }
+
+    m_texels.resize(offset, 0);
+    for (size_t i = 0; i < m_levels.size(); i++)
+    {
+        const Level& level = m_levels[i];
+        const uint32_t* texels = &linear[linearLevels[i].offset];
+        for (int y = 0; y < level.height; y++)
+        {
+            for (int x = 0; x < level.width; x++)
+            {
+                m_texels[level.offset + TexelIndex(level, x, y)] = texels[(size_t)y * level.width + x];
+            }
+        }
+    }
+}
+
+float3 Texture::Sample(float u, float v, float lod) const
+{
+    return (this->*m_sample)(u, v, lod);
+}
+
+template <Texture::Layout TexelLayout>
+float3 Texture::SampleLayout(float u, float v, float lod) const
+{
+    assert(u > -0.0001f && u < 1.0001f);
+    assert(v > -0.0001f && v < 1.0001f);
+
+    const int lastLevel = GetLevelCount() - 1;
+    switch (filter)
+    {
+    case Filter::Bilinear:
+    {
+        const int level = std::min(std::max((int)floorf(lod + 0.5f), 0), lastLevel);
+        return SampleBilinear<TexelLayout>(level, u, v);
+    }
+    case Filter::Trilinear:
+    {
+        lod = fminf(fmaxf(lod, 0.0f), (float)lastLevel);
+        const int level = (int)lod;
+        const float fraction = lod - level;
+        if (level == lastLevel || fraction == 0.0f)
+        {
+            return SampleBilinear<TexelLayout>(level, u, v);
+        }
+
+        return SampleBilinear<TexelLayout>(level, u, v) * (1.0f - fraction) + SampleBilinear<TexelLayout>(level + 1, u, v) * fraction;
+    }
+    default:
+        return SampleNearest<TexelLayout>(0, u, v);
+    }
+}
+
+template <Texture::Layout TexelLayout>
+float3 Texture::SampleNearest(int level, float u, float v) const
+{
+    const int x = std::min((int)(u * GetWidth(level)), GetWidth(level) - 1);
+    const int y = std::min((int)(v * GetHeight(level)), GetHeight(level) - 1);
+
+    return ToColor(Fetch<TexelLayout>(level, x, y));
+}
+
+template <Texture::Layout TexelLayout>
+float3 Texture::SampleBilinear(int level, float u, float v) const
+{
+    const int width = GetWidth(level);
+    const int height = GetHeight(level);
+
+    // Texel centers are at half integers
+    const float x = u * width - 0.5f;
+    const float y = v * height - 0.5f;
+    const float xFloor = floorf(x);
+    const float yFloor = floorf(y);
+    const float fractionX = x - xFloor;
+    const float fractionY = y - yFloor;
+
+    // Clamp to edge
+    const int x0 = std::min(std::max((int)xFloor, 0), width - 1);
+    const int y0 = std::min(std::max((int)yFloor, 0), height - 1);
+    const int x1 = std::min(std::max((int)xFloor + 1, 0), width - 1);
+    const int y1 = std::min(std::max((int)yFloor + 1, 0), height - 1);
+
+    const float3 top = ToColor(Fetch<TexelLayout>(level, x0, y0)) * (1.0f - fractionX) + ToColor(Fetch<TexelLayout>(level, x1, y0)) * fractionX;
+    const float3 bottom = ToColor(Fetch<TexelLayout>(level, x0, y1)) * (1.0f - fractionX) + ToColor(Fetch<TexelLayout>(level, x1, y1)) * fractionX;
+
+    return top * (1.0f - fractionY) + bottom * fractionY;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "math/float3.h"
+
+class Buffer;
+
+// Color image with a full mip chain, built once when the texture is created
+class Texture
+{
+public:
+    enum class Filter
+    {
+        Point,      // nearest texel of the full resolution level
+        Bilinear,   // 4 texels of the mip level closest to the LOD
+        Trilinear,  // bilinear in the two mip levels around the LOD, blended
+    };
+
+    // Order of the texels in memory. Swizzled layouts keep 2D neighbourhoods in the same cache lines, which is meant
+    // to help when UVs move across rows. For the textures and scenes of rasterizer_bench they are slower than
+    // Linear so far, their index math costs more than the misses they save. Sampling gives the same results with any layout.
+    enum class Layout
+    {
+        Linear,     // row by row
+        Tiled,      // 4x4 blocks of texels (64 bytes, a cache line), blocks row by row
+        Morton,     // Z-order curve, levels are padded to power of two sizes
+    };
+
+    explicit Texture(const Buffer& image, Layout layout = Layout::Linear);
+
+    // u, v in [0, 1]. lod is log2 of the texels of level 0 covered by one pixel.
+    float3 Sample(float u, float v, float lod) const;
+
+    int GetWidth(int level = 0) const { return m_levels[level].width; }
+    int GetHeight(int level = 0) const { return m_levels[level].height; }
+    int GetLevelCount() const { return (int)m_levels.size(); }
+    uint32_t TexelAt(int level, int x, int y) const { return m_texels[m_levels[level].offset + TexelIndex(m_levels[level], x, y)]; }
+    Layout GetLayout() const { return m_layout; }
+
+    Filter filter = Filter::Trilinear;
+
+private:
+    static constexpr int TileSize = 4;
+
+    struct Level
+    {
+        int width;
+        int height;
+        size_t offset; // of the first texel in m_texels
+        size_t size; // texels taken in m_texels, more than width * height when the layout needs padding
+        int tilesX; // Tiled: blocks per row
+        int mortonBits; // Morton: bits of x and y that are interleaved, the rest of the longer side goes above them
+    };
+
+    template <Layout TexelLayout>
+    static size_t TexelIndex(const Level& level, int x, int y);
+    size_t TexelIndex(const Level& level, int x, int y) const;
+
+    // Sampling is compiled once per layout, so texel fetches don't check the layout
+    template <Layout TexelLayout>
+    uint32_t Fetch(int level, int x, int y) const { return m_texels[m_levels[level].offset + TexelIndex<TexelLayout>(m_levels[level], x, y)]; }
+    template <Layout TexelLayout>
+    float3 SampleLayout(float u, float v, float lod) const;
+    template <Layout TexelLayout>
+    float3 SampleNearest(int level, float u, float v) const;
+    template <Layout TexelLayout>
+    float3 SampleBilinear(int level, float u, float v) const;
+
+    typedef float3 (Texture::*SampleFunction)(float u, float v, float lod) const;
+
+    Layout m_layout;
+    SampleFunction m_sample; // SampleLayout of m_layout
+    std::vector<Level> m_levels;
+    // All levels one after another, largest first
+    std::vector<uint32_t> m_texels;
+};
+
+// Spreads the low 16 bits of value to the even bits
+inline uint32_t SpreadBits(uint32_t value)
+{
+    value &= 0x0000ffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+
+    return value;
+}
+
+template <>
+inline size_t Texture::TexelIndex<Texture::Layout::Linear>(const Level& level, int x, int y)
+{
+    return (size_t)y * level.width + x;
+}
+
+template <>
+inline size_t Texture::TexelIndex<Texture::Layout::Tiled>(const Level& level, int x, int y)
+{
+    const int tile = (y / TileSize) * level.tilesX + x / TileSize;
+    return (size_t)tile * TileSize * TileSize + (y % TileSize) * TileSize + x % TileSize;
+}
+
+template <>
+inline size_t Texture::TexelIndex<Texture::Layout::Morton>(const Level& level, int x, int y)
+{
+    const uint32_t mask = (1u << level.mortonBits) - 1;
+    const size_t low = SpreadBits((uint32_t)x & mask) | (SpreadBits((uint32_t)y & mask) << 1);
+    const size_t high = (size_t)(((uint32_t)x | (uint32_t)y) >> level.mortonBits);
+    return low | (high << (2 * level.mortonBits));
+}
+
+inline size_t Texture::TexelIndex(const Level& level, int x, int y) const
+{
+    switch (m_layout)
+    {
+    case Layout::Tiled: return TexelIndex<Layout::Tiled>(level, x, y);
+    case Layout::Morton: return TexelIndex<Layout::Morton>(level, x, y);
+    default: return TexelIndex<Layout::Linear>(level, x, y);
+    }
+}
@@ -0,0 +1,122 @@
+#include "threadPool.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <string>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	threadCount = std::max(threadCount, 1u);
+
+	// The thread calling ParallelFor is one of the workers
+	for (unsigned int i = 0; i < threadCount - 1; i++)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i + 1);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_wakeWorkers.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(int jobCount, const std::function<void(int)>& job)
+{
+	if (jobCount <= 0)
+	{
+		return;
+	}
+
+	// Only one ParallelFor uses the workers at a time. Others (from another thread, or nested in a job) run serially.
+	if (m_workers.empty() || jobCount == 1 || m_inUse.exchange(true))
+	{
+		for (int i = 0; i < jobCount; i++)
+		{
+			job(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_jobCount = jobCount;
+		m_nextJob = 0;
+		m_finishedJobs = 0;
+		m_generation++;
+	}
+	m_wakeWorkers.notify_all();
+
+	RunJobs(job, jobCount);
+
+	// Workers that woke up late may still hold a pointer to the job, so wait for them to leave as well
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_jobsDone.wait(lock, [this]() { return m_finishedJobs == m_jobCount && m_activeWorkers == 0; });
+	m_job = nullptr;
+	m_inUse = false;
+}
+
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool pool(std::thread::hardware_concurrency());
+	return pool;
+}
+
+void ThreadPool::WorkerLoop(unsigned int index)
+{
+	Profiler::SetThreadName(("Worker " + std::to_string(index)).c_str());
+
+	unsigned int seenGeneration = 0;
+
+	while (true)
+	{
+		// Copied under the lock: once every job of a call is done, ParallelFor may clear them or start the next call
+		const std::function<void(int)>* job = nullptr;
+		int jobCount = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeWorkers.wait(lock, [&]() { return m_shutdown || m_generation != seenGeneration; });
+			if (m_shutdown)
+			{
+				return;
+			}
+			seenGeneration = m_generation;
+
+			// Woke up after the call was already done by the others
+			if (m_job == nullptr || m_nextJob >= m_jobCount)
+			{
+				continue;
+			}
+			job = m_job;
+			jobCount = m_jobCount;
+			m_activeWorkers++;
+		}
+
+		RunJobs(*job, jobCount);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeWorkers--;
+		}
+		m_jobsDone.notify_all();
+	}
+}
+
+void ThreadPool::RunJobs(const std::function<void(int)>& job, int jobCount)
+{
+	for (int i = m_nextJob++; i < jobCount; i = m_nextJob++)
+	{
+		job(i);
+		m_finishedJobs++;
+	}
+}
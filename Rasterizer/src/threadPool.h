@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Calls job(i) for every i in [0, jobCount) and returns once all of them are done.
+	// The calling thread takes part in the work, so a pool of 1 thread runs everything serially.
+	// Safe to call from several threads, while the workers are busy with one call the others run serially.
+	void ParallelFor(int jobCount, const std::function<void(int)>& job);
+
+	unsigned int GetThreadCount() const { return (unsigned int)m_workers.size() + 1; }
+
+	// Shared pool sized to the machine, created on first use
+	static ThreadPool& Get();
+
+private:
+	// index of the worker thread, counting from 1
+	void WorkerLoop(unsigned int index);
+	void RunJobs(const std::function<void(int)>& job, int jobCount);
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeWorkers;
+	std::condition_variable m_jobsDone;
+
+	const std::function<void(int)>* m_job = nullptr;
+	int m_jobCount = 0;
+	std::atomic<int> m_nextJob{0};
+	std::atomic<int> m_finishedJobs{0};
+	unsigned int m_generation = 0;
+	int m_activeWorkers = 0;
+	bool m_shutdown = false;
+	std::atomic<bool> m_inUse{false};
+};